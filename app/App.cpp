@@ -3,238 +3,1450 @@
 #include <chrono>
 #include <random>
 #include <fstream>
+#include <cstdio>
 #include <string>
 #include <map>
+#include <deque>
 #include <algorithm>
-#include <time.h>
+#include <memory>
+#include <type_traits>
+#include <thread>
+#include <mutex>
+#include <atomic>
 #include "AVLTree.h"
 #include "SplayTree.h"
 #include "TreapTree.h"
+#include "CompactTree.h"
+#include "PersistentTree.h"
+#include "TreapSequence.h"
+#include "BTree.h"
+#include "NodePool.h"
+#include "TreeSnapshot.h"
+#include "TreeImage.h"
+#include "ConcurrentAVLTree.h"
+#include "ShardedTree.h"
+#include "Benchmark.h"
+#include "Workload.h"
+#include "Generator.h"
 
-void generateIntData(std::mt19937& mersenne, std::vector<int>& dataBase, const size_t sizeDataBase, const std::pair<int, int>& spanData)
+std::atomic<size_t> benchmarkSink(0);
+
+void generatePriority(const benchmarkOptions& options, std::vector<int>& priority, const size_t sizeDataBase)
 {
-    int randNum = 0;
-    std::vector<bool> repeat(spanData.second, false);
+    generateUniqueInts(priority, sizeDataBase, { 1, static_cast<int>(2 * sizeDataBase) + 1 }, options.seed ^ 0x5bd1e995u);
+}
 
-    for (size_t i = 0; i < sizeDataBase; ++i)
+void generateData(const benchmarkOptions& options, std::vector<int>& dataBase, std::vector<int>& priority)
+{
+    if (!options.cache.empty() && loadDataset(options.cache, options.seed, options.size, dataBase, priority))
+        return;
+    generateUniqueInts(dataBase, options.size, { 1, static_cast<int>(2 * options.size) }, options.seed);
+    generatePriority(options, priority, options.size);
+    if (!options.cache.empty() && !saveDataset(options.cache, options.seed, dataBase, priority))
+        std::cerr << "File \"" << options.cache << "\" is not written" << std::endl;
+}
+
+void generateData(const benchmarkOptions& options, std::vector<std::string>& dataBase, std::vector<int>& priority)
+{
+    stringArena arena;
+    if (options.cache.empty() || !loadDataset(options.cache, options.seed, options.size, arena, priority))
     {
-        randNum = mersenne() % (spanData.second - spanData.first) + spanData.first;
-        while (repeat[randNum])
-        {
-            randNum = mersenne() % (spanData.second - spanData.first) + spanData.first;
-        }
-        dataBase.push_back(randNum);
-        repeat[randNum] = true;
+        generateStrings(arena, options.size, { 50, 60 }, options.seed);
+        generatePriority(options, priority, options.size);
+        if (!options.cache.empty() && !saveDataset(options.cache, options.seed, arena, priority))
+            std::cerr << "File \"" << options.cache << "\" is not written" << std::endl;
     }
+    dataBase.assign(arena.views.begin(), arena.views.end());
+}
+
+template <typename TypeTree, typename TypeKey>
+void insertElement(TypeTree& tree, const TypeKey& key, int)
+{
+    tree.insert({ key, key });
+}
+
+template <typename TypeKey, typename TypeData>
+void insertElement(std::map<TypeKey, TypeData>& tree, const TypeKey& key, int)
+{
+    tree.emplace(key, key);
+}
+
+template <typename TypeKey, typename TypeData, typename TypeAlloc, typename TypeStats, typename TypeOrder, typename TypeCompare>
+void insertElement(AVLTree<TypeKey, TypeData, TypeAlloc, TypeStats, TypeOrder, TypeCompare>& tree, const TypeKey& key, int)
+{
+    tree.emplace(key, key);
+}
+
+template <typename TypeKey, typename TypeData, typename TypeAlloc, typename TypeStats, typename TypeOrder, typename TypeCompare>
+void insertElement(SplayTree<TypeKey, TypeData, TypeAlloc, TypeStats, TypeOrder, TypeCompare>& tree, const TypeKey& key, int)
+{
+    tree.emplace(key, key);
+}
+
+template <typename TypeKey, typename TypePriority, typename TypeData, typename TypeAlloc, typename TypeStats, typename TypeOrder, typename TypeCompare, typename TypePriorityGen>
+void insertElement(TreapTree<TypeKey, TypePriority, TypeData, TypeAlloc, TypeStats, TypeOrder, TypeCompare, TypePriorityGen>& tree, const TypeKey& key, int priority)
+{
+    tree.emplace(key, priority, key);
+}
+
+template <typename TypeKey, typename TypePriority, typename TypeData, typename TypeAlloc, typename TypeCompare, typename TypePriorityGen>
+void insertElement(PersistentTreapTree<TypeKey, TypePriority, TypeData, TypeAlloc, TypeCompare, TypePriorityGen>& tree, const TypeKey& key, int priority)
+{
+    tree.emplace(key, priority, key);
+}
+
+template <typename TypeTree, typename TypeKey>
+void insertElement(TypeTree& tree, const TypeKey& key, int priority, std::false_type)
+{
+    insertElement(tree, key, priority);
+}
+
+template <typename TypeTree, typename TypeKey>
+void insertElement(TypeTree& tree, const TypeKey& key, int, std::true_type)
+{
+    tree.insert({ key, key });
+}
+
+template <typename TypeTree, typename TypeKey>
+bool findElement(TypeTree& tree, const TypeKey& key)
+{
+    return !(tree.find(key) == TypeKey());
+}
+
+template <typename TypeKey, typename TypeData>
+bool findElement(std::map<TypeKey, TypeData>& tree, const TypeKey& key)
+{
+    return tree.find(key) != tree.end();
+}
+
+template <typename TypeKey, typename TypeData, typename TypeAlloc, typename TypeStats, typename TypeOrder, typename TypeCompare>
+bool findElement(AVLTree<TypeKey, TypeData, TypeAlloc, TypeStats, TypeOrder, TypeCompare>& tree, const TypeKey& key)
+{
+    return tree.contains(key);
+}
+
+template <typename TypeKey, typename TypeData, typename TypeAlloc, typename TypeStats, typename TypeOrder, typename TypeCompare>
+bool findElement(SplayTree<TypeKey, TypeData, TypeAlloc, TypeStats, TypeOrder, TypeCompare>& tree, const TypeKey& key)
+{
+    return tree.contains(key);
+}
+
+template <typename TypeKey, typename TypePriority, typename TypeData, typename TypeAlloc, typename TypeStats, typename TypeOrder, typename TypeCompare, typename TypePriorityGen>
+bool findElement(TreapTree<TypeKey, TypePriority, TypeData, TypeAlloc, TypeStats, TypeOrder, TypeCompare, TypePriorityGen>& tree, const TypeKey& key)
+{
+    return tree.contains(key);
+}
+
+template <typename TypeKey, typename TypeData, typename TypeCompare>
+bool findElement(CompactAVLTree<TypeKey, TypeData, TypeCompare>& tree, const TypeKey& key)
+{
+    return tree.contains(key);
+}
+
+template <typename TypeKey, typename TypeData, typename TypeCompare>
+bool findElement(CompactSplayTree<TypeKey, TypeData, TypeCompare>& tree, const TypeKey& key)
+{
+    return tree.contains(key);
+}
+
+template <typename TypeKey, typename TypeData, typename TypeCompare>
+bool findElement(CompactTreapTree<TypeKey, TypeData, TypeCompare>& tree, const TypeKey& key)
+{
+    return tree.contains(key);
+}
+
+template <typename TypeKey, typename TypeData, typename TypeAlloc, typename TypeCompare>
+bool findElement(PersistentAVLTree<TypeKey, TypeData, TypeAlloc, TypeCompare>& tree, const TypeKey& key)
+{
+    return tree.contains(key);
+}
+
+template <typename TypeKey, typename TypePriority, typename TypeData, typename TypeAlloc, typename TypeCompare, typename TypePriorityGen>
+bool findElement(PersistentTreapTree<TypeKey, TypePriority, TypeData, TypeAlloc, TypeCompare, TypePriorityGen>& tree, const TypeKey& key)
+{
+    return tree.contains(key);
+}
+
+template <typename TypeTree, typename TypeKey>
+size_t scanRange(const TypeTree& tree, const TypeKey& lo, const TypeKey& hi)
+{
+    size_t visited = 0;
+    tree.for_each_in_range(lo, hi, [&visited](const TypeKey&, const TypeKey&) { visited++; });
+    return visited;
+}
+
+template <typename TypeKey, typename TypeData>
+size_t scanRange(const std::map<TypeKey, TypeData>& tree, const TypeKey& lo, const TypeKey& hi)
+{
+    size_t visited = 0;
+    for (auto it = tree.lower_bound(lo); it != tree.end() && it->first < hi; ++it)
+        visited++;
+    return visited;
+}
+
+template <typename TypeTree, typename TypeKey>
+void insertBatch(TypeTree& tree, std::vector<std::pair<TypeKey, TypeKey>> batch, std::vector<int>)
+{
+    tree.insert_batch(std::move(batch));
+}
+
+template <typename TypeKey, typename TypePriority, typename TypeData, typename TypeAlloc, typename TypeStats, typename TypeOrder, typename TypeCompare, typename TypePriorityGen>
+void insertBatch(TreapTree<TypeKey, TypePriority, TypeData, TypeAlloc, TypeStats, TypeOrder, TypeCompare, TypePriorityGen>& tree, std::vector<std::pair<TypeKey, TypeKey>> batch, std::vector<int> priorities)
+{
+    tree.insert_batch(std::move(batch), std::move(priorities));
+}
+
+template <typename TypeTree, typename TypeKey>
+void insertBatch(TypeTree& tree, std::vector<std::pair<TypeKey, TypeKey>> batch, std::vector<int> priorities, std::false_type)
+{
+    insertBatch(tree, std::move(batch), std::move(priorities));
+}
+
+template <typename TypeTree, typename TypeKey>
+void insertBatch(TypeTree& tree, std::vector<std::pair<TypeKey, TypeKey>> batch, std::vector<int>, std::true_type)
+{
+    tree.insert_batch(std::move(batch));
+}
+
+template <typename TypeTree, typename TypeKey>
+void buildTree(TypeTree& tree, const std::vector<std::pair<TypeKey, TypeKey>>& elements, const std::vector<int>&)
+{
+    tree.build(elements.begin(), elements.end());
+}
+
+template <typename TypeKey, typename TypePriority, typename TypeData, typename TypeAlloc, typename TypeStats, typename TypeOrder, typename TypeCompare, typename TypePriorityGen>
+void buildTree(TreapTree<TypeKey, TypePriority, TypeData, TypeAlloc, TypeStats, TypeOrder, TypeCompare, TypePriorityGen>& tree, const std::vector<std::pair<TypeKey, TypeKey>>& elements, const std::vector<int>& priorities)
+{
+    tree.build(elements.begin(), elements.end(), priorities.begin());
+}
+
+template <typename TypeTree, typename TypeKey>
+void buildTree(TypeTree& tree, const std::vector<std::pair<TypeKey, TypeKey>>& elements, const std::vector<int>& priorities, std::false_type)
+{
+    buildTree(tree, elements, priorities);
+}
+
+template <typename TypeTree, typename TypeKey>
+void buildTree(TypeTree& tree, const std::vector<std::pair<TypeKey, TypeKey>>& elements, const std::vector<int>&, std::true_type)
+{
+    tree.build(elements.begin(), elements.end());
+}
+
+template <typename TypeSequence, typename TypeValue>
+void insertAt(TypeSequence& sequence, size_t index, const TypeValue& value)
+{
+    sequence.insert(sequence.begin() + index, value);
 }
 
-void generateStringData(std::mt19937& mersenne, std::vector<std::string>& dataBase, const size_t sizeDataBase, const std::pair<int, int>& spanData)
+template <typename TypeValue, typename TypeAlloc>
+void insertAt(TreapSequence<TypeValue, TypeAlloc>& sequence, size_t index, const TypeValue& value)
 {
-    const std::string charSet = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ1234567890";
-    for (size_t i = 0; i < sizeDataBase; ++i)
+    sequence.insert(index, value);
+}
+
+template <typename TypeSequence>
+void eraseRange(TypeSequence& sequence, size_t first, size_t last)
+{
+    sequence.erase(sequence.begin() + first, sequence.begin() + last);
+}
+
+template <typename TypeValue, typename TypeAlloc>
+void eraseRange(TreapSequence<TypeValue, TypeAlloc>& sequence, size_t first, size_t last)
+{
+    sequence.erase(first, last);
+}
+
+template <typename TypeSequence>
+void reverseRange(TypeSequence& sequence, size_t first, size_t last)
+{
+    std::reverse(sequence.begin() + first, sequence.begin() + last);
+}
+
+template <typename TypeValue, typename TypeAlloc>
+void reverseRange(TreapSequence<TypeValue, TypeAlloc>& sequence, size_t first, size_t last)
+{
+    sequence.reverse(first, last);
+}
+
+template <typename TypeSequence>
+void moveRange(TypeSequence& sequence, size_t first, size_t last, size_t index)
+{
+    TypeSequence cut(std::make_move_iterator(sequence.begin() + first), std::make_move_iterator(sequence.begin() + last));
+    sequence.erase(sequence.begin() + first, sequence.begin() + last);
+    sequence.insert(sequence.begin() + index, std::make_move_iterator(cut.begin()), std::make_move_iterator(cut.end()));
+}
+
+template <typename TypeValue, typename TypeAlloc>
+void moveRange(TreapSequence<TypeValue, TypeAlloc>& sequence, size_t first, size_t last, size_t index)
+{
+    TreapSequence<TypeValue, TypeAlloc> cut = sequence.slice(first, last);
+    sequence.splice(index, cut);
+}
+
+template <typename TypeSequence, typename TypeValue>
+void appendValue(TypeSequence& sequence, const TypeValue& value)
+{
+    TypeSequence one(1, value);
+    sequence.insert(sequence.end(), std::make_move_iterator(one.begin()), std::make_move_iterator(one.end()));
+}
+
+template <typename TypeValue, typename TypeAlloc>
+void appendValue(TreapSequence<TypeValue, TypeAlloc>& sequence, const TypeValue& value)
+{
+    TreapSequence<TypeValue, TypeAlloc> one;
+    one.push_back(value);
+    sequence.append(one);
+}
+
+template <typename TypeTree, typename TypeKey, typename TypeValue>
+void insertValue(TypeTree& tree, const TypeKey& key, int, const TypeValue& value)
+{
+    tree.emplace(key, value);
+}
+
+template <typename TypeKey, typename TypePriority, typename TypeData, typename TypeAlloc, typename TypeStats, typename TypeOrder, typename TypeCompare, typename TypePriorityGen, typename TypeValue>
+void insertValue(TreapTree<TypeKey, TypePriority, TypeData, TypeAlloc, TypeStats, TypeOrder, TypeCompare, TypePriorityGen>& tree, const TypeKey& key, int priority, const TypeValue& value)
+{
+    tree.emplace(key, priority, value);
+}
+
+template <typename TypeTree, typename Iterator, typename TypeValue>
+void updateRange(TypeTree& tree, Iterator first, Iterator last, const TypeValue& delta)
+{
+    for (; first != last; ++first)
+        tree.update(*first, [&delta](TypeValue& data) { data += delta; });
+}
+
+template <typename TypeKey, typename TypePriority, typename TypeData, typename TypeAlloc, typename TypeStats, typename TypeMonoid, typename TypeCompare, typename TypePriorityGen, typename Iterator, typename TypeValue>
+void updateRange(TreapTree<TypeKey, TypePriority, TypeData, TypeAlloc, TypeStats, lazySubtreeAggregate<TypeMonoid>, TypeCompare, TypePriorityGen>& tree, Iterator first, Iterator last, const TypeValue& delta)
+{
+    tree.update_range(*first, *last, delta);
+}
+
+template <typename Factory, typename TypeTree, typename TypeKey>
+std::unique_ptr<TypeTree> snapshotTree(Factory make, const TypeTree& tree, std::vector<std::pair<TypeKey, TypeKey>>& elements)
+{
+    elements.clear();
+    tree.for_each([&elements](const TypeKey& key, const TypeKey& data) { elements.push_back({ key, data }); });
+    std::unique_ptr<TypeTree> copy = make();
+    copy->build(elements.begin(), elements.end());
+    return copy;
+}
+
+template <typename Factory, typename TypeKey, typename TypeData, typename TypeAlloc, typename TypeCompare>
+std::unique_ptr<PersistentAVLTree<TypeKey, TypeData, TypeAlloc, TypeCompare>> snapshotTree(Factory,
+    const PersistentAVLTree<TypeKey, TypeData, TypeAlloc, TypeCompare>& tree, std::vector<std::pair<TypeKey, TypeKey>>&)
+{
+    return std::unique_ptr<PersistentAVLTree<TypeKey, TypeData, TypeAlloc, TypeCompare>>(new PersistentAVLTree<TypeKey, TypeData, TypeAlloc, TypeCompare>(tree.snapshot()));
+}
+
+template <typename Factory, typename TypeKey, typename TypePriority, typename TypeData, typename TypeAlloc, typename TypeCompare, typename TypePriorityGen>
+std::unique_ptr<PersistentTreapTree<TypeKey, TypePriority, TypeData, TypeAlloc, TypeCompare, TypePriorityGen>> snapshotTree(Factory,
+    const PersistentTreapTree<TypeKey, TypePriority, TypeData, TypeAlloc, TypeCompare, TypePriorityGen>& tree, std::vector<std::pair<TypeKey, TypeKey>>&)
+{
+    return std::unique_ptr<PersistentTreapTree<TypeKey, TypePriority, TypeData, TypeAlloc, TypeCompare, TypePriorityGen>>(
+        new PersistentTreapTree<TypeKey, TypePriority, TypeData, TypeAlloc, TypeCompare, TypePriorityGen>(tree.snapshot()));
+}
+
+template <typename TypeTree, typename TypeKey, typename TypeData>
+class LockedTree
+{
+    TypeTree tree;
+    std::mutex lock;
+public:
+    void insert(const std::pair<TypeKey, TypeData>& value)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        tree.insert(value);
+    }
+
+    void erase(const TypeKey& key)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        tree.erase(key);
+    }
+
+    TypeData find(const TypeKey& key)
     {
-        std::string randString;
-        int lengthRandString = mersenne() % (spanData.second - spanData.first) + spanData.first;
-        for (size_t j = 0; j < lengthRandString; ++j)
+        std::lock_guard<std::mutex> guard(lock);
+        return tree.find(key);
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        tree.clear();
+    }
+};
+
+template <typename TypeTree>
+struct treeFactory
+{
+    std::unique_ptr<TypeTree> operator()() const
+    {
+        return std::unique_ptr<TypeTree>(new TypeTree());
+    }
+};
+
+template <typename TypeTree>
+struct generatedPriorityFactory
+{
+    std::unique_ptr<TypeTree> operator()() const
+    {
+        return std::unique_ptr<TypeTree>(new TypeTree());
+    }
+};
+
+template <typename Factory>
+struct generatesPriority : std::false_type
+{
+};
+
+template <typename TypeTree>
+struct generatesPriority<generatedPriorityFactory<TypeTree>> : std::true_type
+{
+};
+
+template <typename TypeTree>
+struct recursiveTreeFactory
+{
+    std::unique_ptr<TypeTree> operator()() const
+    {
+        std::unique_ptr<TypeTree> tree(new TypeTree());
+        tree->setIterative(false);
+        return tree;
+    }
+};
+
+template <typename TypeTree>
+struct shardedTreeFactory
+{
+    size_t shards;
+
+    explicit shardedTreeFactory(size_t shards_) : shards(shards_) {}
+
+    std::unique_ptr<TypeTree> operator()() const
+    {
+        return std::unique_ptr<TypeTree>(new TypeTree(shards));
+    }
+};
+
+template <typename TypeKey>
+std::vector<std::pair<TypeKey, TypeKey>> makeElements(const std::vector<TypeKey>& dataBase, size_t first, size_t last)
+{
+    std::vector<std::pair<TypeKey, TypeKey>> elements;
+    elements.reserve(last - first);
+    for (size_t i = first; i < last; ++i)
+    {
+        elements.push_back({ dataBase[i], dataBase[i] });
+    }
+    return elements;
+}
+
+template <typename Factory, typename TypeKey>
+std::vector<benchmarkSample> runBasic(Factory make, const benchmarkOptions& options,
+    const std::vector<TypeKey>& dataBase, const std::vector<int>& priority)
+{
+    std::vector<benchmarkSample> run;
+    auto tree = make();
+    const size_t step = options.step;
+    const size_t iteration = dataBase.size() / step;
+
+    for (size_t k = 0; k < iteration; ++k)
+    {
+        benchmarkTimer insertTimer;
+        for (size_t i = k * step; i < (k + 1) * step; ++i)
         {
-            int randChar = mersenne() % 61;
-            randString.push_back(charSet[randChar]);
+            insertElement(*tree, dataBase[i], priority[i], generatesPriority<Factory>());
         }
-        dataBase.push_back(randString);
+        run.push_back({ "insert", 1, k * step, insertTimer.nsPerOp(step), insertTimer.countersPerOp(step) });
+
+        size_t hits = 0;
+        benchmarkTimer findTimer;
+        for (size_t i = k * step; i < (k + 1) * step; ++i)
+        {
+            hits += findElement(*tree, dataBase[i]);
+        }
+        run.push_back({ "find", 1, (k + 1) * step, findTimer.nsPerOp(step), findTimer.countersPerOp(step) });
+        benchmarkSink += hits;
+    }
+
+    for (size_t k = 0; k < iteration; ++k)
+    {
+        benchmarkTimer removeTimer;
+        for (size_t i = k * step; i < (k + 1) * step; ++i)
+        {
+            tree->erase(dataBase[i]);
+        }
+        run.push_back({ "remove", 1, dataBase.size() - k * step, removeTimer.nsPerOp(step), removeTimer.countersPerOp(step) });
+    }
+    return run;
+}
+
+template <typename Factory, typename TypeKey>
+std::vector<benchmarkSample> runBatch(Factory make, const benchmarkOptions& options,
+    const std::vector<TypeKey>& dataBase, const std::vector<int>& priority)
+{
+    std::vector<benchmarkSample> run;
+    auto tree = make();
+    const size_t step = options.step;
+    const size_t iteration = dataBase.size() / step;
+
+    for (size_t k = 0; k < iteration; ++k)
+    {
+        std::vector<std::pair<TypeKey, TypeKey>> batch = makeElements(dataBase, k * step, (k + 1) * step);
+        std::vector<int> priorities(priority.begin() + k * step, priority.begin() + (k + 1) * step);
+        benchmarkTimer insertTimer;
+        insertBatch(*tree, std::move(batch), std::move(priorities), generatesPriority<Factory>());
+        run.push_back({ "insert_batch", 1, k * step, insertTimer.nsPerOp(step), insertTimer.countersPerOp(step) });
+
+        std::vector<TypeKey> keys(dataBase.begin() + k * step, dataBase.begin() + (k + 1) * step);
+        benchmarkTimer findTimer;
+        std::vector<TypeKey> found = tree->find_batch(keys);
+        run.push_back({ "find_batch", 1, (k + 1) * step, findTimer.nsPerOp(step), findTimer.countersPerOp(step) });
+        benchmarkSink += found.size();
+    }
+
+    for (size_t k = 0; k < iteration; ++k)
+    {
+        std::vector<TypeKey> keys(dataBase.begin() + k * step, dataBase.begin() + (k + 1) * step);
+        benchmarkTimer removeTimer;
+        tree->erase_batch(std::move(keys));
+        run.push_back({ "erase_batch", 1, dataBase.size() - k * step, removeTimer.nsPerOp(step), removeTimer.countersPerOp(step) });
     }
+    return run;
+}
+
+template <typename Factory, typename TypeKey>
+std::vector<benchmarkSample> runBuild(Factory make, const benchmarkOptions&,
+    const std::vector<TypeKey>& dataBase, const std::vector<int>& priority)
+{
+    std::vector<size_t> order = orderBatch(dataBase, keyCompare());
+    std::vector<std::pair<TypeKey, TypeKey>> elements;
+    std::vector<int> priorities;
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        elements.push_back({ dataBase[order[i]], dataBase[order[i]] });
+        priorities.push_back(priority[order[i]]);
+    }
+
+    auto tree = make();
+    benchmarkTimer timer;
+    buildTree(*tree, elements, priorities, generatesPriority<Factory>());
+    return std::vector<benchmarkSample>(1, { "build", 1, dataBase.size(), timer.nsPerOp(dataBase.size()), timer.countersPerOp(dataBase.size()) });
 }
 
-void writeInFile(const std::string& fileWrite, const std::vector<std::pair<int, int>>& timesOperation)
+template <typename Factory, typename TypeKey>
+std::vector<benchmarkSample> runSetOperations(Factory make, const benchmarkOptions&,
+    const std::vector<TypeKey>& dataBase, const std::vector<int>& priority)
 {
-    std::ofstream out;
-    out.open(fileWrite);
-    if (out.is_open())
+    std::vector<size_t> order = orderBatch(dataBase, keyCompare());
+    std::vector<std::pair<TypeKey, TypeKey>> firstElements;
+    std::vector<std::pair<TypeKey, TypeKey>> secondElements;
+    std::vector<int> firstPriority;
+    std::vector<int> secondPriority;
+    for (size_t j = 0; j < order.size(); ++j)
     {
-        for (size_t i = 0; i < timesOperation.size(); ++i)
+        size_t i = order[j];
+        if (i < dataBase.size() * 2 / 3)
         {
-            out << timesOperation[i].first << " " << timesOperation[i].second << "\n";
+            firstElements.push_back({ dataBase[i], dataBase[i] });
+            firstPriority.push_back(priority[i]);
+        }
+        if (i >= dataBase.size() / 3)
+        {
+            secondElements.push_back({ dataBase[i], dataBase[i] });
+            secondPriority.push_back(priority[i]);
         }
     }
-    else
+
+    std::vector<benchmarkSample> run;
+    const char* operations[] = { "unite", "intersect", "difference" };
+    for (int operation = 0; operation < 3; ++operation)
     {
-        std::cout << "File \"" << fileWrite << "\" is not open" << std::endl;
+        auto first = make();
+        auto second = make();
+        buildTree(*first, firstElements, firstPriority, generatesPriority<Factory>());
+        buildTree(*second, secondElements, secondPriority, generatesPriority<Factory>());
+
+        benchmarkTimer timer;
+        if (operation == 0)
+            first->unite(*second);
+        else if (operation == 1)
+            first->intersect(*second);
+        else
+            first->difference(*second);
+        run.push_back({ operations[operation], 1, dataBase.size(), timer.nsPerOp(firstElements.size() + secondElements.size()), timer.countersPerOp(firstElements.size() + secondElements.size()) });
     }
-    out.close();
+    return run;
+}
+
+template <typename Factory, typename TypeKey>
+std::vector<benchmarkSample> runSet(Factory, const benchmarkOptions&,
+    const std::vector<TypeKey>&, const std::vector<int>&, std::false_type)
+{
+    return std::vector<benchmarkSample>();
+}
+
+template <typename Factory, typename TypeKey>
+std::vector<benchmarkSample> runSet(Factory make, const benchmarkOptions& options,
+    const std::vector<TypeKey>& dataBase, const std::vector<int>& priority, std::true_type)
+{
+    return runSetOperations(make, options, dataBase, priority);
 }
 
-template <typename TypeTree, typename TypeDataBase>
-void measureTimeInsertAndFind(TypeTree& tree, const TypeDataBase& dataBase,
-    const size_t iteration, const size_t step,
-    const std::string& fileWriterInsert, const std::string& fileWriterFind)
+template <typename Factory, typename TypeKey>
+std::vector<benchmarkSample> runSnapshot(Factory make, const benchmarkOptions& options,
+    const std::vector<TypeKey>& dataBase, const std::vector<int>& priority)
 {
-    std::vector<std::pair<int, int>> timesInsert;
-    std::vector<std::pair<int, int>> timesFind;
+    std::vector<benchmarkSample> run;
+    auto tree = make();
+    TreeSnapshot<TypeKey, TypeKey> snapshot;
+    const size_t step = options.step;
+    const size_t iteration = dataBase.size() / step;
 
     for (size_t k = 0; k < iteration; ++k)
     {
-        auto begin = std::chrono::steady_clock::now();
         for (size_t i = k * step; i < (k + 1) * step; ++i)
         {
-            tree.insert({ dataBase[i], dataBase[i] });
+            insertElement(*tree, dataBase[i], priority[i], generatesPriority<Factory>());
         }
-        auto end = std::chrono::steady_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - begin);
-        timesInsert.push_back({ k * step, elapsed.count() });
+        benchmarkTimer freezeTimer;
+        snapshot.freeze(*tree);
+        run.push_back({ "freeze", 1, (k + 1) * step, freezeTimer.nsPerOp((k + 1) * step), freezeTimer.countersPerOp((k + 1) * step) });
 
-        begin = std::chrono::steady_clock::now();
+        size_t hits = 0;
+        benchmarkTimer findTimer;
         for (size_t i = k * step; i < (k + 1) * step; ++i)
         {
-            tree.find(dataBase[i]);
+            hits += findElement(snapshot, dataBase[i]);
         }
-        end = std::chrono::steady_clock::now();
-        elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - begin);
-        timesFind.push_back({ k * step, elapsed.count() });
+        run.push_back({ "find", 1, (k + 1) * step, findTimer.nsPerOp(step), findTimer.countersPerOp(step) });
+        benchmarkSink += hits;
     }
-
-    writeInFile(fileWriterInsert, timesInsert);
-    writeInFile(fileWriterFind, timesFind);
+    return run;
 }
 
-template <typename TypeTree, typename TypeDataBase>
-void measureTimeInsertAndFind(TypeTree& tree, const TypeDataBase& dataBase,
-    const size_t iteration, const size_t step, const std::vector<int> priority,
-    const std::string& fileWriterInsert, const std::string& fileWriterFind)
+template <typename Factory, typename TypeKey>
+std::vector<benchmarkSample> runVersions(Factory make, const benchmarkOptions& options,
+    const std::vector<TypeKey>& dataBase, const std::vector<int>& priority)
 {
-    std::vector<std::pair<int, int>> timesInsert;
-    std::vector<std::pair<int, int>> timesFind;
+    std::vector<benchmarkSample> run;
+    auto tree = make();
+    auto version = make();
+    std::vector<std::pair<TypeKey, TypeKey>> elements;
+    const size_t step = options.step;
+    const size_t iteration = dataBase.size() / step;
 
     for (size_t k = 0; k < iteration; ++k)
     {
-        auto begin = std::chrono::steady_clock::now();
+        benchmarkTimer insertTimer;
         for (size_t i = k * step; i < (k + 1) * step; ++i)
         {
-            tree.insert(dataBase[i], priority[i], dataBase[i]);
+            insertElement(*tree, dataBase[i], priority[i], generatesPriority<Factory>());
         }
-        auto end = std::chrono::steady_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - begin);
-        timesInsert.push_back({ k * step, elapsed.count() });
+        run.push_back({ "insert", 1, k * step, insertTimer.nsPerOp(step), insertTimer.countersPerOp(step) });
+
+        version.reset();
+        benchmarkTimer snapshotTimer;
+        version = snapshotTree(make, *tree, elements);
+        run.push_back({ "snapshot", 1, (k + 1) * step, snapshotTimer.nsPerOp(1), snapshotTimer.countersPerOp(1) });
 
-        begin = std::chrono::steady_clock::now();
+        size_t hits = 0;
+        benchmarkTimer findTimer;
         for (size_t i = k * step; i < (k + 1) * step; ++i)
         {
-            tree.find(dataBase[i]);
+            hits += findElement(*version, dataBase[i]);
         }
-        end = std::chrono::steady_clock::now();
-        elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - begin);
-        timesFind.push_back({ k * step, elapsed.count() });
+        run.push_back({ "find", 1, (k + 1) * step, findTimer.nsPerOp(step), findTimer.countersPerOp(step) });
+        benchmarkSink += hits;
     }
-
-    writeInFile(fileWriterInsert, timesInsert);
-    writeInFile(fileWriterFind, timesFind);
+    return run;
 }
 
-template <typename TypeTree, typename TypeDataBase>
-void measureTimeRemove(TypeTree& tree, const TypeDataBase& dataBase,
-    const size_t iteration, const size_t step, const std::string fileWriterRemove)
+template <typename Factory, typename TypeKey>
+std::vector<benchmarkSample> runEdits(Factory make, const benchmarkOptions& options,
+    const std::vector<TypeKey>& dataBase, const std::vector<int>& priority)
 {
-    std::vector<std::pair<int, int>> timesRemove;
+    std::vector<benchmarkSample> run;
+    auto sequence = make();
+    const size_t step = options.step;
+    const size_t iteration = dataBase.size() / step;
 
     for (size_t k = 0; k < iteration; ++k)
     {
-        auto begin = std::chrono::steady_clock::now();
+        benchmarkTimer insertTimer;
         for (size_t i = k * step; i < (k + 1) * step; ++i)
         {
-            tree.erase(dataBase[i]);
+            insertAt(*sequence, priority[i] % (i + 1), dataBase[i]);
+        }
+        run.push_back({ "insert", 1, k * step, insertTimer.nsPerOp(step), insertTimer.countersPerOp(step) });
+
+        const size_t size = (k + 1) * step;
+        size_t hits = 0;
+        benchmarkTimer readTimer;
+        for (size_t i = k * step; i < (k + 1) * step; ++i)
+        {
+            hits += (*sequence)[priority[i] % size] == dataBase[i];
+        }
+        run.push_back({ "read", 1, size, readTimer.nsPerOp(step), readTimer.countersPerOp(step) });
+        benchmarkSink += hits;
+
+        const size_t span = std::min(options.range, size);
+        benchmarkTimer reverseTimer;
+        for (size_t i = k * step; i < (k + 1) * step; ++i)
+        {
+            size_t first = priority[i] % (size - span + 1);
+            reverseRange(*sequence, first, first + span);
+        }
+        run.push_back({ "reverse", 1, size, reverseTimer.nsPerOp(step), reverseTimer.countersPerOp(step) });
+
+        benchmarkTimer moveTimer;
+        for (size_t i = k * step; i < (k + 1) * step; ++i)
+        {
+            size_t first = priority[i] % (size - span + 1);
+            moveRange(*sequence, first, first + span, priority[size - 1 - (i - k * step)] % (size - span + 1));
         }
-        auto end = std::chrono::steady_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - begin);
-        timesRemove.push_back({ dataBase.size() - k * step, elapsed.count() });
+        run.push_back({ "move", 1, size, moveTimer.nsPerOp(step), moveTimer.countersPerOp(step) });
     }
 
-    writeInFile(fileWriterRemove, timesRemove);
+    for (size_t k = 0; k < iteration; ++k)
+    {
+        const size_t size = dataBase.size() - k * step;
+        benchmarkTimer eraseTimer;
+        for (size_t i = k * step; i < (k + 1) * step; ++i)
+        {
+            size_t first = priority[i] % (size - (i - k * step));
+            eraseRange(*sequence, first, first + 1);
+        }
+        run.push_back({ "erase", 1, size, eraseTimer.nsPerOp(step), eraseTimer.countersPerOp(step) });
+    }
+
+    const size_t base = sequence->size();
+    for (size_t k = 0; k < iteration; ++k)
+    {
+        benchmarkTimer appendTimer;
+        for (size_t i = k * step; i < (k + 1) * step; ++i)
+        {
+            appendValue(*sequence, dataBase[i]);
+        }
+        run.push_back({ "append", 1, k * step, appendTimer.nsPerOp(step), appendTimer.countersPerOp(step) });
+
+        const size_t size = (k + 1) * step;
+        size_t hits = 0;
+        benchmarkTimer readTimer;
+        for (size_t i = k * step; i < (k + 1) * step; ++i)
+        {
+            size_t index = priority[i] % size;
+            hits += (*sequence)[base + index] == dataBase[index];
+        }
+        run.push_back({ "append_read", 1, size, readTimer.nsPerOp(step), readTimer.countersPerOp(step) });
+        benchmarkSink += hits;
+    }
+    return run;
 }
 
-int main(int argc, char* argv[])
+template <typename Factory, typename TypeKey>
+std::vector<benchmarkSample> runMemory(Factory make, const benchmarkOptions&,
+    const std::vector<TypeKey>& dataBase, const std::vector<int>& priority)
+{
+    std::vector<benchmarkSample> run;
+    const size_t n = dataBase.size();
+    size_t heap = heapBytes();
+    auto tree = make();
+    benchmarkTimer insertTimer;
+    for (size_t i = 0; i < n; ++i)
+    {
+        insertElement(*tree, dataBase[i], priority[i], generatesPriority<Factory>());
+    }
+    run.push_back({ "insert", 1, n, insertTimer.nsPerOp(n), insertTimer.countersPerOp(n) });
+    size_t treeBytes = memoryGrowth(heap, heapBytes());
+
+    size_t hits = 0;
+    benchmarkTimer findTimer;
+    for (size_t i = 0; i < n; ++i)
+    {
+        hits += findElement(*tree, dataBase[i]);
+    }
+    run.push_back({ "find", 1, n, findTimer.nsPerOp(n), findTimer.countersPerOp(n) });
+    benchmarkSink += hits;
+    std::cerr << "memory: " << static_cast<double>(treeBytes) / n << " bytes/key allocated" << std::endl;
+    return run;
+}
+
+template <typename Factory, typename TypeKey>
+std::vector<benchmarkSample> runImage(Factory make, const benchmarkOptions& options,
+    const std::vector<TypeKey>& dataBase, const std::vector<int>& priority)
+{
+    std::vector<benchmarkSample> run;
+    const size_t n = dataBase.size();
+    size_t heap = heapBytes();
+    auto tree = make();
+    benchmarkTimer insertTimer;
+    for (size_t i = 0; i < n; ++i)
+    {
+        insertElement(*tree, dataBase[i], priority[i], generatesPriority<Factory>());
+    }
+    run.push_back({ "insert", 1, n, insertTimer.nsPerOp(n), insertTimer.countersPerOp(n) });
+    size_t treeBytes = memoryGrowth(heap, heapBytes());
+
+    benchmarkTimer saveTimer;
+    bool saved = tree->save(options.image);
+    run.push_back({ "save", 1, n, saveTimer.nsPerOp(n), saveTimer.countersPerOp(n) });
+    tree.reset();
+    if (!saved)
+    {
+        std::cerr << "File \"" << options.image << "\" is not written" << std::endl;
+        return std::vector<benchmarkSample>();
+    }
+
+    auto loaded = make();
+    benchmarkTimer loadTimer;
+    loaded->load(options.image);
+    run.push_back({ "load", 1, n, loadTimer.nsPerOp(n), loadTimer.countersPerOp(n) });
+
+    size_t hits = 0;
+    benchmarkTimer findTimer;
+    for (size_t i = 0; i < n; ++i)
+    {
+        hits += findElement(*loaded, dataBase[i]);
+    }
+    run.push_back({ "find", 1, n, findTimer.nsPerOp(n), findTimer.countersPerOp(n) });
+    loaded.reset();
+
+    size_t resident = residentBytes();
+    treeImageView<TypeKey, TypeKey> view;
+    benchmarkTimer mapTimer;
+    view.open(options.image);
+    run.push_back({ "map", 1, n, mapTimer.nsPerOp(n), mapTimer.countersPerOp(n) });
+
+    benchmarkTimer viewTimer;
+    for (size_t i = 0; i < n; ++i)
+    {
+        hits += view.contains(dataBase[i]);
+    }
+    run.push_back({ "view_find", 1, n, viewTimer.nsPerOp(n), viewTimer.countersPerOp(n) });
+    size_t viewBytes = memoryGrowth(resident, residentBytes());
+    view.close();
+    benchmarkSink += hits;
+
+    std::ifstream image(options.image, std::ios::binary | std::ios::ate);
+    double fileBytes = static_cast<double>(image.tellg());
+    image.close();
+    std::remove(options.image.c_str());
+    std::cerr << "image: " << fileBytes / n << " bytes/key on disk, " << static_cast<double>(treeBytes) / n
+        << " bytes/key allocated by the tree, " << static_cast<double>(viewBytes) / n << " bytes/key resident in the view" << std::endl;
+    return run;
+}
+
+template <typename Factory, typename TypeKey>
+std::vector<benchmarkSample> runRangeScan(Factory make, const benchmarkOptions& options,
+    const std::vector<TypeKey>& dataBase, const std::vector<int>& priority)
 {
-    std::random_device rd;
-    std::mt19937 mersenne(rd());
+    std::vector<benchmarkSample> run;
+    auto tree = make();
+    for (size_t i = 0; i < dataBase.size(); ++i)
+    {
+        insertElement(*tree, dataBase[i], priority[i], generatesPriority<Factory>());
+    }
 
-    const std::string fileWriterInsertForMap = "..\\..\\..\\script\\timesInsertInMap.txt";
-    const std::string fileWriterFindForMap = "..\\..\\..\\script\\timesFindInMap.txt";
-    const std::string fileWriterRemoveForMap = "..\\..\\..\\script\\timesRemoveInMap.txt";
+    std::vector<TypeKey> sorted(dataBase);
+    std::sort(sorted.begin(), sorted.end());
+    const size_t width = std::max<size_t>(1, std::min(options.range, sorted.size() - 1));
+    const size_t scans = std::max<size_t>(1, options.operations / width);
+    const size_t chunk = std::max<size_t>(1, options.step / width);
+    std::mt19937 mersenne(options.seed);
+    std::uniform_int_distribution<size_t> start(0, sorted.size() > width ? sorted.size() - 1 - width : 0);
 
-    const std::string fileWriterInsertForAVLTree = "..\\..\\..\\script\\timesInsertInAVLTree.txt";
-    const std::string fileWriterFindForAVLTree = "..\\..\\..\\script\\timesFindInAVLTree.txt";
-    const std::string fileWriterRemoveForAVLTree = "..\\..\\..\\script\\timesRemoveInAVLTree.txt";
+    for (size_t first = 0; first < scans; first += chunk)
+    {
+        std::vector<size_t> starts(std::min(chunk, scans - first));
+        for (size_t i = 0; i < starts.size(); ++i)
+            starts[i] = start(mersenne);
 
-    const std::string fileWriterInsertForSplayTree = "..\\..\\..\\script\\timesInsertInSplayTree.txt";
-    const std::string fileWriterFindForSplayTree = "..\\..\\..\\script\\timesFindInSplayTree.txt";
-    const std::string fileWriterRemoveForSplayTree = "..\\..\\..\\script\\timesRemoveInSplayTree.txt";
+        size_t visited = 0;
+        benchmarkTimer timer;
+        for (size_t i = 0; i < starts.size(); ++i)
+        {
+            visited += scanRange(*tree, sorted[starts[i]], sorted[std::min(starts[i] + width, sorted.size() - 1)]);
+        }
+        run.push_back({ "range_scan", 1, dataBase.size(), timer.nsPerOp(visited), timer.countersPerOp(visited) });
+        benchmarkSink += visited;
+    }
+    return run;
+}
 
-    const std::string fileWriterInsertForTreapTree = "..\\..\\..\\script\\timesInsertInTreapTree.txt";
-    const std::string fileWriterFindForTreapTree = "..\\..\\..\\script\\timesFindInTreapTree.txt";
-    const std::string fileWriterRemoveForTreapTree = "..\\..\\..\\script\\timesRemoveInTreapTree.txt";
+template <typename Factory, typename TypeKey>
+std::vector<benchmarkSample> runAggregate(Factory make, const benchmarkOptions& options,
+    const std::vector<TypeKey>& dataBase, const std::vector<int>& priority)
+{
+    std::vector<benchmarkSample> run;
+    auto tree = make();
+    const size_t step = options.step;
+    for (size_t first = 0; first < dataBase.size(); first += step)
+    {
+        size_t last = std::min(first + step, dataBase.size());
+        benchmarkTimer timer;
+        for (size_t i = first; i < last; ++i)
+        {
+            insertValue(*tree, dataBase[i], priority[i], static_cast<long long>(priority[i] % 100));
+        }
+        run.push_back({ "insert", 1, first, timer.nsPerOp(last - first), timer.countersPerOp(last - first) });
+    }
 
-    const int step = 10000;
-    const int iteration = 200;
-    const bool flag = false;
+    std::vector<TypeKey> sorted(dataBase);
+    std::sort(sorted.begin(), sorted.end());
+    const size_t width = std::max<size_t>(1, std::min(options.range, sorted.size() - 1));
+    const size_t queries = std::max<size_t>(1, options.operations / width);
+    const size_t chunk = std::min(queries, step);
+    std::mt19937 mersenne(options.seed);
+    std::uniform_int_distribution<size_t> start(0, sorted.size() > width ? sorted.size() - 1 - width : 0);
 
-    if (flag)
+    long long total = 0;
+    for (size_t first = 0; first < queries; first += chunk)
     {
-        std::vector<int> dataBaseInt;
-        std::vector<int> priority;
-        AVLTree<int, int> avlTree;
-        std::map<int, int> rbTree;
-        SplayTree<int, int> splayTree;
-        TreapTree<int, int, int> treapTree;
+        std::vector<size_t> starts(std::min(chunk, queries - first));
+        for (size_t i = 0; i < starts.size(); ++i)
+            starts[i] = start(mersenne);
 
-        std::cout << "Generation data..." << std::endl;
-        generateIntData(mersenne, dataBaseInt, step * iteration, { 1, 2 * step * iteration });
-        generateIntData(mersenne, priority, step * iteration, { 1, 2 * step * iteration });
+        benchmarkTimer scanTimer;
+        for (size_t i = 0; i < starts.size(); ++i)
+        {
+            tree->for_each_in_range(sorted[starts[i]], sorted[starts[i] + width],
+                [&total](const TypeKey&, const long long& data) { total += data; });
+        }
+        run.push_back({ "scan", 1, dataBase.size(), scanTimer.nsPerOp(starts.size()), scanTimer.countersPerOp(starts.size()) });
 
-        std::cout << "Run operations..." << std::endl;
+        benchmarkTimer aggregateTimer;
+        for (size_t i = 0; i < starts.size(); ++i)
+        {
+            total += tree->aggregate(sorted[starts[i]], sorted[starts[i] + width]);
+        }
+        run.push_back({ "aggregate", 1, dataBase.size(), aggregateTimer.nsPerOp(starts.size()), aggregateTimer.countersPerOp(starts.size()) });
 
-        measureTimeInsertAndFind(rbTree, dataBaseInt, iteration, step, fileWriterInsertForMap, fileWriterFindForMap);
-        measureTimeRemove(rbTree, dataBaseInt, iteration, step, fileWriterRemoveForMap);
-        std::cout << "Map done." << std::endl;
+        benchmarkTimer updateTimer;
+        for (size_t i = 0; i < starts.size(); ++i)
+        {
+            tree->update(sorted[starts[i]], [](long long& data) { data += 1; });
+        }
+        run.push_back({ "update", 1, dataBase.size(), updateTimer.nsPerOp(starts.size()), updateTimer.countersPerOp(starts.size()) });
 
-        measureTimeInsertAndFind(avlTree, dataBaseInt, iteration, step, fileWriterInsertForAVLTree, fileWriterFindForAVLTree);
-        measureTimeRemove(avlTree, dataBaseInt, iteration, step, fileWriterRemoveForAVLTree);
-        std::cout << "AVL done." << std::endl;
+        benchmarkTimer rangeTimer;
+        for (size_t i = 0; i < starts.size(); ++i)
+        {
+            updateRange(*tree, sorted.begin() + starts[i], sorted.begin() + starts[i] + width, 1LL);
+        }
+        run.push_back({ "update_range", 1, dataBase.size(), rangeTimer.nsPerOp(starts.size()), rangeTimer.countersPerOp(starts.size()) });
+    }
+    benchmarkSink += static_cast<size_t>(total);
+    return run;
+}
 
-        measureTimeInsertAndFind(splayTree, dataBaseInt, iteration, step, fileWriterInsertForSplayTree, fileWriterFindForSplayTree);
-        measureTimeRemove(splayTree, dataBaseInt, iteration, step, fileWriterRemoveForSplayTree);
-        std::cout << "Splay done." << std::endl;
+template <typename Factory, typename TypeKey>
+std::vector<benchmarkSample> runRange(Factory, const benchmarkOptions&,
+    const std::vector<TypeKey>&, const std::vector<int>&, std::false_type)
+{
+    return std::vector<benchmarkSample>();
+}
 
-        measureTimeInsertAndFind(treapTree, dataBaseInt, iteration, step, priority, fileWriterInsertForTreapTree, fileWriterFindForTreapTree);
-        measureTimeRemove(treapTree, dataBaseInt, iteration, step, fileWriterRemoveForTreapTree);
-        std::cout << "Treap done." << std::endl;
+template <typename Factory, typename TypeKey>
+std::vector<benchmarkSample> runRange(Factory make, const benchmarkOptions& options,
+    const std::vector<TypeKey>& dataBase, const std::vector<int>& priority, std::true_type)
+{
+    return runRangeScan(make, options, dataBase, priority);
+}
+
+template <typename Factory, typename TypeKey>
+std::vector<benchmarkSample> runThroughput(Factory make, const benchmarkOptions& options,
+    const std::vector<TypeKey>& dataBase, bool ingest)
+{
+    std::vector<benchmarkSample> run;
+    for (unsigned threads = 1; ; threads = std::min(2 * threads, options.threads))
+    {
+        auto tree = make();
+        if (!ingest)
+        {
+            for (size_t i = 0; i < dataBase.size(); ++i)
+            {
+                tree->insert({ dataBase[i], dataBase[i] });
+            }
+        }
+
+        size_t slice = dataBase.size() / threads;
+        std::vector<std::thread> workers;
+        benchmarkTimer timer;
+        for (unsigned t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&tree, &dataBase, slice, t, ingest]()
+            {
+                size_t hits = 0;
+                size_t index = t * slice;
+                for (size_t i = 0; i < slice; ++i)
+                {
+                    if (ingest)
+                    {
+                        tree->insert({ dataBase[t * slice + i], dataBase[t * slice + i] });
+                        continue;
+                    }
+                    index = (index + 104729) % dataBase.size();
+                    if (i % 16 == 0)
+                        tree->insert({ dataBase[index], dataBase[index] });
+                    else
+                        hits += findElement(*tree, dataBase[index]);
+                }
+                benchmarkSink += hits;
+            });
+        }
+        for (size_t t = 0; t < workers.size(); ++t)
+        {
+            workers[t].join();
+        }
+        run.push_back({ ingest ? "insert" : "mixed", threads, dataBase.size(), timer.nsPerOp(slice * threads), counterSample() });
+        if (threads == options.threads) break;
+    }
+    return run;
+}
+
+template <typename Factory, typename TypeKey>
+std::vector<benchmarkSample> runStream(Factory make, const benchmarkOptions& options,
+    const std::vector<TypeKey>& dataBase, const std::vector<int>& priority, const workloadStream& stream)
+{
+    std::vector<benchmarkSample> run;
+    auto tree = make();
+    for (size_t i = 0; i < stream.prefill; ++i)
+    {
+        insertElement(*tree, dataBase[i], priority[i], generatesPriority<Factory>());
+    }
+
+    size_t elements = stream.prefill;
+    size_t hits = 0;
+    for (size_t first = 0; first < stream.ops.size(); first += options.step)
+    {
+        size_t last = std::min(first + options.step, stream.ops.size());
+        size_t start = elements;
+        benchmarkTimer timer;
+        for (size_t i = first; i < last; ++i)
+        {
+            const workloadOp& op = stream.ops[i];
+            if (op.operation == opInsert)
+            {
+                insertElement(*tree, dataBase[op.index], priority[op.index], generatesPriority<Factory>());
+                elements++;
+            }
+            else if (op.operation == opFind)
+            {
+                hits += findElement(*tree, dataBase[op.index]);
+            }
+            else
+            {
+                tree->erase(dataBase[op.index]);
+                elements -= elements > 0;
+            }
+        }
+        run.push_back({ stream.label, 1, start, timer.nsPerOp(last - first), timer.countersPerOp(last - first) });
+    }
+    benchmarkSink += hits;
+    return run;
+}
+
+bool isStreamWorkload(const std::string& workload)
+{
+    return workload == "zipf" || workload == "hotset" || workload == "ascending" || workload == "descending" ||
+        workload == "window" || workload == "mix" || workload == "trace";
+}
+
+template <typename RangeScan, typename Factory, typename TypeKey>
+std::vector<benchmarkSample> runPlain(Factory make, const benchmarkOptions& options,
+    const std::vector<TypeKey>& dataBase, const std::vector<int>& priority, const workloadStream& stream)
+{
+    if (isStreamWorkload(options.workload))
+        return runStream(make, options, dataBase, priority, stream);
+    if (options.workload == "basic")
+        return runBasic(make, options, dataBase, priority);
+    if (options.workload == "range")
+        return runRange(make, options, dataBase, priority, RangeScan());
+    if (options.workload == "memory")
+        return runMemory(make, options, dataBase, priority);
+    return std::vector<benchmarkSample>();
+}
+
+template <typename SetOperations, typename Factory, typename TypeKey>
+std::vector<benchmarkSample> runOrdered(Factory make, const benchmarkOptions& options,
+    const std::vector<TypeKey>& dataBase, const std::vector<int>& priority, const workloadStream& stream)
+{
+    if (isStreamWorkload(options.workload))
+        return runStream(make, options, dataBase, priority, stream);
+    if (options.workload == "basic")
+        return runBasic(make, options, dataBase, priority);
+    if (options.workload == "batch")
+        return runBatch(make, options, dataBase, priority);
+    if (options.workload == "build")
+        return runBuild(make, options, dataBase, priority);
+    if (options.workload == "set")
+        return runSet(make, options, dataBase, priority, SetOperations());
+    if (options.workload == "snapshot")
+        return runSnapshot(make, options, dataBase, priority);
+    if (options.workload == "range")
+        return runRangeScan(make, options, dataBase, priority);
+    if (options.workload == "image")
+        return runImage(make, options, dataBase, priority);
+    if (options.workload == "versions")
+        return runVersions(make, options, dataBase, priority);
+    if (options.workload == "memory")
+        return runMemory(make, options, dataBase, priority);
+    return std::vector<benchmarkSample>();
+}
+
+template <typename Factory, typename TypeKey>
+std::vector<benchmarkSample> runPersistent(Factory make, const benchmarkOptions& options,
+    const std::vector<TypeKey>& dataBase, const std::vector<int>& priority, const workloadStream& stream)
+{
+    if (options.workload == "versions")
+        return runVersions(make, options, dataBase, priority);
+    return runPlain<std::false_type>(make, options, dataBase, priority, stream);
+}
+
+template <typename Factory, typename TypeKey>
+std::vector<benchmarkSample> runSequence(Factory make, const benchmarkOptions& options,
+    const std::vector<TypeKey>& dataBase, const std::vector<int>& priority)
+{
+    if (options.workload == "edits")
+        return runEdits(make, options, dataBase, priority);
+    return std::vector<benchmarkSample>();
+}
+
+template <typename Factory, typename TypeKey>
+std::vector<benchmarkSample> runAggregated(Factory make, const benchmarkOptions& options,
+    const std::vector<TypeKey>& dataBase, const std::vector<int>& priority)
+{
+    if (options.workload == "aggregate")
+        return runAggregate(make, options, dataBase, priority);
+    return std::vector<benchmarkSample>();
+}
+
+template <typename Factory, typename TypeKey>
+std::vector<benchmarkSample> runConcurrent(Factory make, const benchmarkOptions& options,
+    const std::vector<TypeKey>& dataBase, const std::vector<int>& priority, const workloadStream& stream, bool ingest)
+{
+    if (isStreamWorkload(options.workload))
+        return runStream(make, options, dataBase, priority, stream);
+    if (options.workload == "basic")
+        return runBasic(make, options, dataBase, priority);
+    if (options.workload == "throughput")
+        return runThroughput(make, options, dataBase, ingest);
+    return std::vector<benchmarkSample>();
+}
+
+template <typename TypeTree, typename TypeKey>
+treeStatsRow collectStats(const std::string& structure, const benchmarkOptions& options, bool iterative,
+    const std::vector<TypeKey>& dataBase, const std::vector<int>& priority, const workloadStream& stream)
+{
+    TypeTree tree;
+    tree.setIterative(iterative);
+    bool replay = isStreamWorkload(options.workload);
+    if (replay)
+    {
+        for (size_t i = 0; i < stream.prefill; ++i)
+            insertElement(tree, dataBase[i], priority[i]);
+        for (size_t i = 0; i < stream.ops.size(); ++i)
+        {
+            const workloadOp& op = stream.ops[i];
+            if (op.operation == opInsert)
+                insertElement(tree, dataBase[op.index], priority[op.index]);
+            else if (op.operation == opFind)
+                benchmarkSink += findElement(tree, dataBase[op.index]);
+            else
+                tree.erase(dataBase[op.index]);
+        }
     }
     else
     {
-        std::vector<std::string> dataBaseString;
-        std::vector<int> priority;
-        AVLTree<std::string, std::string> avlTree;
-        std::map<std::string, std::string> rbTree;
-        SplayTree<std::string, std::string> splayTree;
-        TreapTree<std::string, int, std::string> treapTree;
+        for (size_t i = 0; i < dataBase.size(); ++i)
+            insertElement(tree, dataBase[i], priority[i]);
+        for (size_t i = 0; i < dataBase.size(); ++i)
+            benchmarkSink += findElement(tree, dataBase[i]);
+    }
 
-        std::cout << "Generation data..." << std::endl;
-        generateStringData(mersenne, dataBaseString, step * iteration, { 50, 60 });
-        generateIntData(mersenne, priority, step * iteration, { 1, 2 * step * iteration });
+    treeStatsRow row;
+    row.structure = structure;
+    row.shape = tree.getShape();
+    if (!replay)
+    {
+        for (size_t i = 0; i < dataBase.size(); ++i)
+            tree.erase(dataBase[i]);
+    }
+    for (int operation = 0; operation < treeOperationCount; ++operation)
+        row.counters[operation] = tree.getStats().counters(static_cast<treeOperation>(operation));
+    return row;
+}
 
-        std::cout << "Run operations..." << std::endl;
+template <typename TypeKey>
+bool runStats(const std::string& structure, const benchmarkOptions& options,
+    const std::vector<TypeKey>& dataBase, const std::vector<int>& priority, const workloadStream& stream, treeStatsRow& row)
+{
+    typedef std::allocator<std::pair<const TypeKey, TypeKey>> TypeAlloc;
+    typedef AVLTree<TypeKey, TypeKey, TypeAlloc, treeStats> TypeAVL;
+    typedef SplayTree<TypeKey, TypeKey, TypeAlloc, treeStats> TypeSplay;
+    typedef TreapTree<TypeKey, int, TypeKey, TypeAlloc, treeStats> TypeTreap;
 
-        measureTimeInsertAndFind(rbTree, dataBaseString, iteration, step, fileWriterInsertForMap, fileWriterFindForMap);
-        measureTimeRemove(rbTree, dataBaseString, iteration, step, fileWriterRemoveForMap);
-        std::cout << "Map done." << std::endl;
+    bool iterative = structure.find("-recursive") == std::string::npos;
+    bool plain = structure.find("-pool") == std::string::npos && structure.find("-prefix") == std::string::npos;
+    if (structure.compare(0, 3, "avl") == 0 && plain)
+        row = collectStats<TypeAVL>(structure, options, iterative, dataBase, priority, stream);
+    else if (structure.compare(0, 5, "splay") == 0 && plain)
+        row = collectStats<TypeSplay>(structure, options, iterative, dataBase, priority, stream);
+    else if (structure.compare(0, 5, "treap") == 0 && plain)
+        row = collectStats<TypeTreap>(structure, options, iterative, dataBase, priority, stream);
+    else
+        return false;
+    return true;
+}
 
-        measureTimeInsertAndFind(avlTree, dataBaseString, iteration, step, fileWriterInsertForAVLTree, fileWriterFindForAVLTree);
-        measureTimeRemove(avlTree, dataBaseString, iteration, step, fileWriterRemoveForAVLTree);
-        std::cout << "AVL done." << std::endl;
+std::vector<benchmarkSample> runPrefix(const std::string&, const benchmarkOptions&,
+    const std::vector<int>&, const std::vector<int>&, const workloadStream&)
+{
+    return std::vector<benchmarkSample>();
+}
 
-        measureTimeInsertAndFind(splayTree, dataBaseString, iteration, step, fileWriterInsertForSplayTree, fileWriterFindForSplayTree);
-        measureTimeRemove(splayTree, dataBaseString, iteration, step, fileWriterRemoveForSplayTree);
-        std::cout << "Splay done." << std::endl;
+std::vector<benchmarkSample> runPrefix(const std::string& structure, const benchmarkOptions& options,
+    const std::vector<std::string>& dataBase, const std::vector<int>& priority, const workloadStream& stream)
+{
+    typedef std::allocator<std::pair<const std::string, std::string>> TypeAlloc;
+    typedef AVLTree<std::string, std::string, TypeAlloc, noTreeStats, noOrderStatistics, prefixCompare> TypeAVL;
+    typedef SplayTree<std::string, std::string, TypeAlloc, noTreeStats, noOrderStatistics, prefixCompare> TypeSplay;
+    typedef TreapTree<std::string, int, std::string, TypeAlloc, noTreeStats, noOrderStatistics, prefixCompare> TypeTreap;
 
-        measureTimeInsertAndFind(treapTree, dataBaseString, iteration, step, priority, fileWriterInsertForTreapTree, fileWriterFindForTreapTree);
-        measureTimeRemove(treapTree, dataBaseString, iteration, step, fileWriterRemoveForTreapTree);
-        std::cout << "Treap done." << std::endl;
+    if (structure == "avl-prefix")
+        return runOrdered<std::true_type>(treeFactory<TypeAVL>(), options, dataBase, priority, stream);
+    if (structure == "splay-prefix")
+        return runOrdered<std::false_type>(treeFactory<TypeSplay>(), options, dataBase, priority, stream);
+    if (structure == "treap-prefix")
+        return runOrdered<std::true_type>(treeFactory<TypeTreap>(), options, dataBase, priority, stream);
+    return std::vector<benchmarkSample>();
+}
+
+template <typename TypeKey>
+std::vector<benchmarkSample> runStructure(const std::string& structure, const benchmarkOptions& options,
+    const std::vector<TypeKey>& dataBase, const std::vector<int>& priority, const workloadStream& stream)
+{
+    typedef PoolAllocator<std::pair<const TypeKey, TypeKey>> TypePool;
+    typedef AVLTree<TypeKey, TypeKey> TypeAVL;
+    typedef SplayTree<TypeKey, TypeKey> TypeSplay;
+    typedef TreapTree<TypeKey, int, TypeKey> TypeTreap;
+    typedef std::allocator<std::pair<const TypeKey, long long>> TypeSumAlloc;
+
+    if (structure == "map")
+        return runPlain<std::true_type>(treeFactory<std::map<TypeKey, TypeKey>>(), options, dataBase, priority, stream);
+    if (structure == "avl")
+        return runOrdered<std::true_type>(treeFactory<TypeAVL>(), options, dataBase, priority, stream);
+    if (structure == "splay")
+        return runOrdered<std::false_type>(treeFactory<TypeSplay>(), options, dataBase, priority, stream);
+    if (structure == "treap")
+        return runOrdered<std::true_type>(treeFactory<TypeTreap>(), options, dataBase, priority, stream);
+    if (structure == "treap-random")
+        return runOrdered<std::true_type>(generatedPriorityFactory<TypeTreap>(), options, dataBase, priority, stream);
+    if (structure == "treap-hash")
+        return runOrdered<std::true_type>(generatedPriorityFactory<TreapTree<TypeKey, int, TypeKey, std::allocator<std::pair<const TypeKey, TypeKey>>,
+            noTreeStats, noOrderStatistics, keyCompare, hashPriority>>(), options, dataBase, priority, stream);
+    if (structure == "btree")
+        return runPlain<std::false_type>(treeFactory<BTree<TypeKey, TypeKey>>(), options, dataBase, priority, stream);
+    if (structure == "btree-scalar")
+    {
+        setSimdSearchLevel(simdScalar);
+        std::vector<benchmarkSample> run = runPlain<std::false_type>(treeFactory<BTree<TypeKey, TypeKey>>(), options, dataBase, priority, stream);
+        setSimdSearchLevel(detectSimdLevel());
+        return run;
     }
+    if (structure == "avl-pool")
+        return runOrdered<std::true_type>(treeFactory<AVLTree<TypeKey, TypeKey, TypePool>>(), options, dataBase, priority, stream);
+    if (structure == "splay-pool")
+        return runOrdered<std::false_type>(treeFactory<SplayTree<TypeKey, TypeKey, TypePool>>(), options, dataBase, priority, stream);
+    if (structure == "treap-pool")
+        return runOrdered<std::true_type>(treeFactory<TreapTree<TypeKey, int, TypeKey, TypePool>>(), options, dataBase, priority, stream);
+    if (structure == "avl-compact")
+        return runPlain<std::false_type>(treeFactory<CompactAVLTree<TypeKey, TypeKey>>(), options, dataBase, priority, stream);
+    if (structure == "splay-compact")
+        return runPlain<std::false_type>(treeFactory<CompactSplayTree<TypeKey, TypeKey>>(), options, dataBase, priority, stream);
+    if (structure == "treap-compact")
+        return runPlain<std::false_type>(treeFactory<CompactTreapTree<TypeKey, TypeKey>>(), options, dataBase, priority, stream);
+    if (structure == "avl-persistent")
+        return runPersistent(treeFactory<PersistentAVLTree<TypeKey, TypeKey>>(), options, dataBase, priority, stream);
+    if (structure == "treap-persistent")
+        return runPersistent(treeFactory<PersistentTreapTree<TypeKey, int, TypeKey>>(), options, dataBase, priority, stream);
+    if (structure == "vector")
+        return runSequence(treeFactory<std::vector<TypeKey>>(), options, dataBase, priority);
+    if (structure == "deque")
+        return runSequence(treeFactory<std::deque<TypeKey>>(), options, dataBase, priority);
+    if (structure == "treap-sequence")
+        return runSequence(treeFactory<TreapSequence<TypeKey>>(), options, dataBase, priority);
+    if (structure == "avl-aggregate")
+        return runAggregated(treeFactory<AVLTree<TypeKey, long long, TypeSumAlloc, noTreeStats, subtreeAggregate<sumMonoid<long long>>>>(), options, dataBase, priority);
+    if (structure == "splay-aggregate")
+        return runAggregated(treeFactory<SplayTree<TypeKey, long long, TypeSumAlloc, noTreeStats, subtreeAggregate<sumMonoid<long long>>>>(), options, dataBase, priority);
+    if (structure == "treap-aggregate")
+        return runAggregated(treeFactory<TreapTree<TypeKey, int, long long, TypeSumAlloc, noTreeStats, lazySubtreeAggregate<sumMonoid<long long>>>>(), options, dataBase, priority);
+    if (structure == "avl-recursive")
+        return runOrdered<std::true_type>(recursiveTreeFactory<TypeAVL>(), options, dataBase, priority, stream);
+    if (structure == "splay-recursive")
+        return runOrdered<std::false_type>(recursiveTreeFactory<TypeSplay>(), options, dataBase, priority, stream);
+    if (structure == "treap-recursive")
+        return runOrdered<std::true_type>(recursiveTreeFactory<TypeTreap>(), options, dataBase, priority, stream);
+    if (structure == "avl-prefix" || structure == "splay-prefix" || structure == "treap-prefix")
+        return runPrefix(structure, options, dataBase, priority, stream);
+    if (structure == "concurrent-avl")
+        return runConcurrent(treeFactory<ConcurrentAVLTree<TypeKey, TypeKey>>(), options, dataBase, priority, stream, false);
+    if (structure == "locked-avl")
+        return runConcurrent(treeFactory<LockedTree<TypeAVL, TypeKey, TypeKey>>(), options, dataBase, priority, stream, false);
+
+    const std::string sharded = "sharded-avl-";
+    if (structure.compare(0, sharded.size(), sharded) == 0)
+    {
+        size_t shards = std::strtoull(structure.c_str() + sharded.size(), 0, 10);
+        return runConcurrent(shardedTreeFactory<ShardedTree<TypeAVL, TypeKey, TypeKey>>(shards), options, dataBase, priority, stream, true);
+    }
+    return std::vector<benchmarkSample>();
+}
+
+std::vector<std::string> expandStructures(const benchmarkOptions& options)
+{
+    const char* all[] = { "map", "avl", "splay", "treap", "treap-random", "treap-hash", "btree", "btree-scalar", "avl-pool", "splay-pool", "treap-pool",
+        "avl-compact", "splay-compact", "treap-compact", "avl-persistent", "treap-persistent",
+        "vector", "deque", "treap-sequence", "avl-aggregate", "splay-aggregate", "treap-aggregate",
+        "avl-recursive", "splay-recursive", "treap-recursive", "avl-prefix", "splay-prefix", "treap-prefix",
+        "concurrent-avl", "locked-avl", "sharded-avl" };
+    std::vector<std::string> names;
+    for (size_t i = 0; i < options.structures.size(); ++i)
+    {
+        if (options.structures[i] == "all")
+            names.insert(names.end(), std::begin(all), std::end(all));
+        else if (std::find(std::begin(all), std::end(all), options.structures[i]) != std::end(all))
+            names.push_back(options.structures[i]);
+        else
+            std::cerr << "Unknown structure " << options.structures[i] << std::endl;
+    }
+
+    std::vector<std::string> expanded;
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+        if (names[i] != "sharded-avl")
+        {
+            expanded.push_back(names[i]);
+            continue;
+        }
+        if (options.workload != "throughput")
+        {
+            expanded.push_back(names[i] + "-" + std::to_string(options.shards));
+            continue;
+        }
+        for (size_t shards = 1; ; shards = std::min(2 * shards, options.shards))
+        {
+            expanded.push_back(names[i] + "-" + std::to_string(shards));
+            if (shards >= options.shards) break;
+        }
+    }
+    return expanded;
+}
+
+template <typename TypeKey>
+void runBenchmark(const benchmarkOptions& options, std::vector<benchmarkRow>& rows, std::vector<treeStatsRow>& statsRows)
+{
+    std::mt19937 mersenne(options.seed);
+    std::vector<TypeKey> dataBase;
+    std::vector<int> priority;
+
+    workloadStream stream;
+
+    std::cerr << "Generation data..." << std::endl;
+    if (options.workload == "trace")
+    {
+        if (!readTrace(options.trace, dataBase, stream))
+        {
+            std::cerr << "Trace \"" << options.trace << "\" is not readable" << std::endl;
+            return;
+        }
+        generatePriority(options, priority, dataBase.size());
+    }
+    else
+        generateData(options, dataBase, priority);
+
+    if (options.workload == "zipf")
+        stream = makeZipfLookups(mersenne, dataBase.size(), options.operations, options.zipf);
+    else if (options.workload == "hotset")
+        stream = makeHotSetLookups(mersenne, dataBase.size(), options.operations, options.hotFraction, options.hotProbability);
+    else if (options.workload == "ascending" || options.workload == "descending")
+        stream = makeSortedInserts(dataBase, options.workload == "descending");
+    else if (options.workload == "window")
+        stream = makeSlidingWindow(dataBase.size(), options.window);
+    else if (options.workload == "mix")
+        stream = makeMix(mersenne, dataBase.size(), options.operations, options.reads, options.writes, options.erases);
+
+    std::vector<std::string> structures = expandStructures(options);
+    for (size_t s = 0; s < structures.size(); ++s)
+    {
+        size_t first = rows.size();
+        for (int r = 0; r < options.warmup + options.repeat; ++r)
+        {
+            std::vector<benchmarkSample> run = runStructure(structures[s], options, dataBase, priority, stream);
+            if (run.empty())
+                break;
+            if (r >= options.warmup)
+                appendRun(rows, first, structures[s], options, run);
+        }
+        if (rows.size() == first)
+            std::cerr << structures[s] << " skipped: no " << options.workload << " workload." << std::endl;
+        else
+            std::cerr << structures[s] << " done." << std::endl;
+
+        treeStatsRow statsRow;
+        if (!options.stats.empty() && runStats(structures[s], options, dataBase, priority, stream, statsRow))
+            statsRows.push_back(statsRow);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    benchmarkOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        printUsage(std::cerr);
+        return 1;
+    }
+
+    if (options.counters && !hardwareCounters().open())
+        std::cerr << "Hardware counters are unavailable, counter columns are left empty." << std::endl;
+
+    std::vector<benchmarkRow> rows;
+    std::vector<treeStatsRow> statsRows;
+    if (options.key == "int")
+        runBenchmark<int>(options, rows, statsRows);
+    else
+        runBenchmark<std::string>(options, rows, statsRows);
+
+    if (!options.stats.empty())
+    {
+        std::ofstream statsFile(options.stats);
+        if (!statsFile.is_open())
+        {
+            std::cerr << "File \"" << options.stats << "\" is not open" << std::endl;
+            return 1;
+        }
+        writeStatsCsv(statsFile, statsRows, options);
+    }
+
+    std::ofstream file;
+    if (!options.output.empty())
+    {
+        file.open(options.output);
+        if (!file.is_open())
+        {
+            std::cerr << "File \"" << options.output << "\" is not open" << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = options.output.empty() ? std::cout : file;
+    if (options.format == "json")
+        writeJson(out, rows, options.counters);
+    else
+        writeCsv(out, rows, options.counters);
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,438 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "PerfCounters.h"
+#ifdef __linux__
+#include <malloc.h>
+#endif
+#include "TreeStats.h"
+
+struct benchmarkOptions
+{
+    std::vector<std::string> structures;
+    std::string key;
+    std::string workload;
+    size_t size;
+    size_t step;
+    unsigned seed;
+    int warmup;
+    int repeat;
+    unsigned threads;
+    size_t shards;
+    size_t operations;
+    double zipf;
+    double hotFraction;
+    double hotProbability;
+    size_t window;
+    size_t range;
+    double reads;
+    double writes;
+    double erases;
+    std::string trace;
+    std::string cache;
+    std::string image;
+    std::string format;
+    std::string output;
+    std::string stats;
+    bool counters;
+
+    benchmarkOptions() : structures(1, "all"), key("int"), workload("basic"), size(2000000), step(10000), seed(1),
+        warmup(1), repeat(5), threads(2 * std::max(1u, std::thread::hardware_concurrency())), shards(16),
+        operations(0), zipf(0.99), hotFraction(0.2), hotProbability(0.8), window(100000), range(100), reads(80), writes(15), erases(5),
+        image("TreeApp.img"), format("csv"), counters(false) {}
+};
+
+struct benchmarkSample
+{
+    std::string operation;
+    size_t threads;
+    size_t elements;
+    double nsPerOp;
+    counterSample counters;
+};
+
+struct benchmarkRow
+{
+    std::string structure;
+    std::string key;
+    std::string workload;
+    std::string operation;
+    size_t threads;
+    size_t elements;
+    std::vector<double> samples;
+    std::vector<counterSample> counters;
+};
+
+struct treeStatsRow
+{
+    std::string structure;
+    treeCounters counters[treeOperationCount];
+    treeShape shape;
+};
+
+struct benchmarkSummary
+{
+    double mean;
+    double variance;
+    double min;
+    double p50;
+    double p90;
+    double p99;
+    double max;
+};
+
+class benchmarkTimer
+{
+    perfCounters::reading counterBegin;
+    std::chrono::steady_clock::time_point begin;
+public:
+    benchmarkTimer() : counterBegin(hardwareCounters().read()), begin(std::chrono::steady_clock::now()) {}
+
+    double nsPerOp(size_t operations) const
+    {
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin);
+        return static_cast<double>(elapsed.count()) / std::max<size_t>(operations, 1);
+    }
+
+    counterSample countersPerOp(size_t operations) const
+    {
+        return hardwareCounters().perOp(counterBegin, hardwareCounters().read(), operations);
+    }
+};
+
+inline size_t residentBytes()
+{
+#ifdef __linux__
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0;
+    size_t resident = 0;
+    if (statm >> pages >> resident)
+        return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+    return 0;
+}
+
+inline size_t heapBytes()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#else
+    return residentBytes();
+#endif
+}
+
+inline size_t memoryGrowth(size_t begin, size_t now)
+{
+    return now > begin ? now - begin : 0;
+}
+
+inline double percentile(const std::vector<double>& sorted, double fraction)
+{
+    if (sorted.empty()) return 0;
+    double position = fraction * (sorted.size() - 1);
+    size_t lower = static_cast<size_t>(position);
+    size_t upper = std::min(lower + 1, sorted.size() - 1);
+    return sorted[lower] + (position - lower) * (sorted[upper] - sorted[lower]);
+}
+
+inline benchmarkSummary summarize(std::vector<double> samples)
+{
+    benchmarkSummary summary = benchmarkSummary();
+    if (samples.empty()) return summary;
+    std::sort(samples.begin(), samples.end());
+    double sum = 0;
+    for (size_t i = 0; i < samples.size(); ++i)
+        sum += samples[i];
+    summary.mean = sum / samples.size();
+    double squares = 0;
+    for (size_t i = 0; i < samples.size(); ++i)
+        squares += (samples[i] - summary.mean) * (samples[i] - summary.mean);
+    summary.variance = samples.size() > 1 ? squares / (samples.size() - 1) : 0;
+    summary.min = samples.front();
+    summary.p50 = percentile(samples, 0.5);
+    summary.p90 = percentile(samples, 0.9);
+    summary.p99 = percentile(samples, 0.99);
+    summary.max = samples.back();
+    return summary;
+}
+
+inline double counterMean(const std::vector<counterSample>& samples, int counter)
+{
+    double sum = 0;
+    size_t count = 0;
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        if (!std::isnan(samples[i].values[counter]))
+        {
+            sum += samples[i].values[counter];
+            count++;
+        }
+    }
+    return count ? sum / count : std::numeric_limits<double>::quiet_NaN();
+}
+
+inline void appendRun(std::vector<benchmarkRow>& rows, size_t first, const std::string& structure,
+    const benchmarkOptions& options, const std::vector<benchmarkSample>& run)
+{
+    for (size_t i = 0; i < run.size(); ++i)
+    {
+        if (first + i == rows.size())
+        {
+            benchmarkRow row;
+            row.structure = structure;
+            row.key = options.key;
+            row.workload = options.workload;
+            row.operation = run[i].operation;
+            row.threads = run[i].threads;
+            row.elements = run[i].elements;
+            rows.push_back(row);
+        }
+        rows[first + i].samples.push_back(run[i].nsPerOp);
+        rows[first + i].counters.push_back(run[i].counters);
+    }
+}
+
+inline void writeCsv(std::ostream& out, const std::vector<benchmarkRow>& rows, bool counters)
+{
+    out << "structure,key,workload,operation,threads,elements,samples,mean_ns,variance_ns2,stddev_ns,min_ns,p50_ns,p90_ns,p99_ns,max_ns";
+    for (int c = 0; c < counterCount && counters; ++c)
+        out << "," << counterName(c) << "_per_op";
+    out << "\n";
+    out << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < rows.size(); ++i)
+    {
+        const benchmarkRow& row = rows[i];
+        benchmarkSummary s = summarize(row.samples);
+        out << row.structure << "," << row.key << "," << row.workload << "," << row.operation << ","
+            << row.threads << "," << row.elements << "," << row.samples.size() << ","
+            << s.mean << "," << s.variance << "," << std::sqrt(s.variance) << ","
+            << s.min << "," << s.p50 << "," << s.p90 << "," << s.p99 << "," << s.max;
+        for (int c = 0; c < counterCount && counters; ++c)
+        {
+            double value = counterMean(row.counters, c);
+            out << ",";
+            if (!std::isnan(value))
+                out << value;
+        }
+        out << "\n";
+    }
+}
+
+inline void writeJson(std::ostream& out, const std::vector<benchmarkRow>& rows, bool counters)
+{
+    out << "[\n" << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < rows.size(); ++i)
+    {
+        const benchmarkRow& row = rows[i];
+        benchmarkSummary s = summarize(row.samples);
+        out << "  {\"structure\": \"" << row.structure << "\", \"key\": \"" << row.key
+            << "\", \"workload\": \"" << row.workload << "\", \"operation\": \"" << row.operation
+            << "\", \"threads\": " << row.threads << ", \"elements\": " << row.elements
+            << ", \"samples\": " << row.samples.size()
+            << ", \"mean_ns\": " << s.mean << ", \"variance_ns2\": " << s.variance << ", \"stddev_ns\": " << std::sqrt(s.variance)
+            << ", \"min_ns\": " << s.min << ", \"p50_ns\": " << s.p50 << ", \"p90_ns\": " << s.p90
+            << ", \"p99_ns\": " << s.p99 << ", \"max_ns\": " << s.max;
+        for (int c = 0; c < counterCount && counters; ++c)
+        {
+            double value = counterMean(row.counters, c);
+            out << ", \"" << counterName(c) << "_per_op\": ";
+            if (std::isnan(value))
+                out << "null";
+            else
+                out << value;
+        }
+        out << "}" << (i + 1 < rows.size() ? ",\n" : "\n");
+    }
+    out << "]\n";
+}
+
+inline void writeStatsCsv(std::ostream& out, const std::vector<treeStatsRow>& rows, const benchmarkOptions& options)
+{
+    out << "structure,key,workload,operation,operations,comparisons_per_op,rotations_per_op,restructures_per_op,size,height,average_depth\n";
+    out << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < rows.size(); ++i)
+    {
+        const treeStatsRow& row = rows[i];
+        for (int operation = 0; operation < treeOperationCount; ++operation)
+        {
+            const treeCounters& c = row.counters[operation];
+            if (c.operations == 0)
+                continue;
+            out << row.structure << "," << options.key << "," << options.workload << "," << treeOperationName(operation) << ","
+                << c.operations << "," << static_cast<double>(c.comparisons) / c.operations << ","
+                << static_cast<double>(c.rotations) / c.operations << "," << static_cast<double>(c.restructures) / c.operations << ","
+                << row.shape.size << "," << row.shape.height << "," << row.shape.averageDepth << "\n";
+        }
+    }
+}
+
+inline std::vector<std::string> splitList(const std::string& value)
+{
+    std::vector<std::string> items;
+    std::stringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        if (!item.empty())
+            items.push_back(item);
+    }
+    return items;
+}
+
+inline void printUsage(std::ostream& out)
+{
+    out << "Usage: TreeApp [options]\n"
+        << "  --structure LIST  comma-separated structures or \"all\" (default all)\n"
+        << "                    map avl splay treap treap-random treap-hash btree btree-scalar\n"
+        << "                    avl-pool splay-pool treap-pool avl-compact splay-compact treap-compact\n"
+        << "                    avl-persistent treap-persistent avl-recursive splay-recursive treap-recursive\n"
+        << "                    vector deque treap-sequence (edits workload only)\n"
+        << "                    avl-aggregate splay-aggregate treap-aggregate (aggregate workload only)\n"
+        << "                    concurrent-avl locked-avl sharded-avl\n"
+        << "                    avl-prefix splay-prefix treap-prefix (string keys only)\n"
+        << "  --key TYPE        int or string (default int)\n"
+        << "  --workload NAME   basic batch build set snapshot versions range image memory edits aggregate\n"
+        << "                    throughput zipf hotset ascending descending window mix trace (default basic)\n"
+        << "  --size N          number of elements (default 2000000)\n"
+        << "  --step N          elements per measured chunk (default 10000)\n"
+        << "  --seed N          data generator seed (default 1)\n"
+        << "  --warmup N        discarded repetitions (default 1)\n"
+        << "  --repeat N        measured repetitions (default 5)\n"
+        << "  --threads N       maximum thread count for the throughput workload\n"
+        << "  --shards N        maximum shard count for sharded-avl (default 16)\n"
+        << "  --operations N    operations in zipf, hotset, mix, range and aggregate workloads (default size)\n"
+        << "  --zipf S          Zipf exponent (default 0.99)\n"
+        << "  --hot F,P         hot-set fraction F receives probability P of lookups (default 0.2,0.8)\n"
+        << "  --window N        sliding window width (default 100000)\n"
+        << "  --range N         keys visited per range scan or aggregate, or elements reversed and moved per edit (default 100)\n"
+        << "  --mix R,W,E       read, write and erase weights (default 80,15,5)\n"
+        << "  --trace FILE      replay \"insert|find|erase key\" lines from FILE\n"
+        << "  --cache FILE      load the generated dataset from FILE, or save it there\n"
+        << "  --image FILE      tree image written and mapped by the image workload (default TreeApp.img)\n"
+        << "  --counters on|off hardware cycles, instructions, cache and branch misses per op (default off)\n"
+        << "  --stats FILE      write comparisons, rotations, restructuring work and tree shape of avl, splay and treap\n"
+        << "                    (and their -recursive variants) to FILE\n"
+        << "  --format FORMAT   csv or json (default csv)\n"
+        << "  --output FILE     write results to FILE instead of stdout\n";
+}
+
+inline bool parseOptions(int argc, char* argv[], benchmarkOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string name = argv[i];
+        if (name == "--help" || name == "-h")
+            return false;
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Missing value for " << name << std::endl;
+            return false;
+        }
+        std::string value = argv[++i];
+        if (name == "--structure")
+            options.structures = splitList(value);
+        else if (name == "--key")
+            options.key = value;
+        else if (name == "--workload")
+            options.workload = value;
+        else if (name == "--size")
+            options.size = std::strtoull(value.c_str(), 0, 10);
+        else if (name == "--step")
+            options.step = std::strtoull(value.c_str(), 0, 10);
+        else if (name == "--seed")
+            options.seed = static_cast<unsigned>(std::strtoul(value.c_str(), 0, 10));
+        else if (name == "--warmup")
+            options.warmup = std::atoi(value.c_str());
+        else if (name == "--repeat")
+            options.repeat = std::atoi(value.c_str());
+        else if (name == "--threads")
+            options.threads = static_cast<unsigned>(std::strtoul(value.c_str(), 0, 10));
+        else if (name == "--shards")
+            options.shards = std::strtoull(value.c_str(), 0, 10);
+        else if (name == "--operations")
+            options.operations = std::strtoull(value.c_str(), 0, 10);
+        else if (name == "--zipf")
+            options.zipf = std::atof(value.c_str());
+        else if (name == "--hot")
+        {
+            std::vector<std::string> items = splitList(value);
+            if (items.size() != 2)
+            {
+                std::cerr << "Expected --hot F,P" << std::endl;
+                return false;
+            }
+            options.hotFraction = std::atof(items[0].c_str());
+            options.hotProbability = std::atof(items[1].c_str());
+        }
+        else if (name == "--window")
+            options.window = std::strtoull(value.c_str(), 0, 10);
+        else if (name == "--range")
+            options.range = std::strtoull(value.c_str(), 0, 10);
+        else if (name == "--mix")
+        {
+            std::vector<std::string> items = splitList(value);
+            if (items.size() != 3)
+            {
+                std::cerr << "Expected --mix R,W,E" << std::endl;
+                return false;
+            }
+            options.reads = std::atof(items[0].c_str());
+            options.writes = std::atof(items[1].c_str());
+            options.erases = std::atof(items[2].c_str());
+        }
+        else if (name == "--trace")
+            options.trace = value;
+        else if (name == "--cache")
+            options.cache = value;
+        else if (name == "--image")
+            options.image = value;
+        else if (name == "--stats")
+            options.stats = value;
+        else if (name == "--counters")
+            options.counters = value == "on";
+        else if (name == "--format")
+            options.format = value;
+        else if (name == "--output")
+            options.output = value;
+        else
+        {
+            std::cerr << "Unknown option " << name << std::endl;
+            return false;
+        }
+    }
+    if (options.key != "int" && options.key != "string")
+    {
+        std::cerr << "Unknown key type " << options.key << std::endl;
+        return false;
+    }
+    if (options.format != "csv" && options.format != "json")
+    {
+        std::cerr << "Unknown format " << options.format << std::endl;
+        return false;
+    }
+    if (options.step == 0 || options.size < options.step || options.repeat < 1 || options.warmup < 0 || options.threads == 0)
+    {
+        std::cerr << "Invalid size, step, repetition or thread count" << std::endl;
+        return false;
+    }
+    if (options.workload == "trace" && options.trace.empty())
+    {
+        std::cerr << "The trace workload needs --trace FILE" << std::endl;
+        return false;
+    }
+    options.size -= options.size % options.step;
+    if (options.operations == 0)
+        options.operations = options.size;
+    return true;
+}
@@ -0,0 +1,226 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+class keyPermutation
+{
+    uint64_t span;
+    int halfBits;
+    uint64_t halfMask;
+    uint64_t roundKeys[4];
+
+    uint64_t round(uint64_t x, int r) const
+    {
+        x = (x ^ roundKeys[r]) * 0x9E3779B97F4A7C15ull;
+        return (x ^ (x >> 29)) & halfMask;
+    }
+
+    uint64_t encrypt(uint64_t x) const
+    {
+        uint64_t left = x >> halfBits;
+        uint64_t right = x & halfMask;
+        for (int r = 0; r < 4; ++r)
+        {
+            uint64_t next = left ^ round(right, r);
+            left = right;
+            right = next;
+        }
+        return (left << halfBits) | right;
+    }
+public:
+    keyPermutation(uint64_t span_, uint64_t seed) : span(span_ ? span_ : 1), halfBits(1)
+    {
+        while ((uint64_t(1) << (2 * halfBits)) < span)
+            halfBits++;
+        halfMask = (uint64_t(1) << halfBits) - 1;
+        std::mt19937_64 mersenne(seed);
+        for (int r = 0; r < 4; ++r)
+            roundKeys[r] = mersenne();
+    }
+
+    uint64_t operator()(uint64_t i) const
+    {
+        uint64_t x = encrypt(i);
+        while (x >= span)
+            x = encrypt(x);
+        return x;
+    }
+};
+
+template <typename Func>
+void parallelBlocks(size_t n, size_t block, Func func)
+{
+    size_t blocks = (n + block - 1) / block;
+    unsigned threads = static_cast<unsigned>(std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), blocks));
+    std::atomic<size_t> next(0);
+    auto worker = [&]()
+    {
+        for (size_t b = next++; b < blocks; b = next++)
+            func(b, b * block, std::min(n, (b + 1) * block));
+    };
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < threads; ++t)
+        workers.emplace_back(worker);
+    worker();
+    for (size_t t = 0; t < workers.size(); ++t)
+        workers[t].join();
+}
+
+inline std::mt19937 blockStream(unsigned seed, size_t block)
+{
+    std::seed_seq sequence{ seed, static_cast<unsigned>(block), static_cast<unsigned>(static_cast<uint64_t>(block) >> 32) };
+    return std::mt19937(sequence);
+}
+
+inline void generateUniqueInts(std::vector<int>& keys, size_t n, const std::pair<int, int>& spanData, unsigned seed)
+{
+    keyPermutation permutation(static_cast<uint64_t>(spanData.second - spanData.first), seed);
+    keys.resize(n);
+    parallelBlocks(n, 1 << 16, [&](size_t, size_t first, size_t last)
+    {
+        for (size_t i = first; i < last; ++i)
+            keys[i] = spanData.first + static_cast<int>(permutation(i));
+    });
+}
+
+struct stringArena
+{
+    std::vector<char> bytes;
+    std::vector<std::string_view> views;
+};
+
+inline void generateStrings(stringArena& arena, size_t n, const std::pair<int, int>& lengthSpan, unsigned seed)
+{
+    static const char charSet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ1234567890";
+    const uint64_t charCount = sizeof(charSet) - 1;
+    const size_t block = 1 << 16;
+    const size_t blocks = (n + block - 1) / block;
+
+    std::vector<uint32_t> lengths(n);
+    std::vector<std::mt19937> streams(blocks);
+    parallelBlocks(n, block, [&](size_t b, size_t first, size_t last)
+    {
+        std::mt19937 mersenne = blockStream(seed, b);
+        std::uniform_int_distribution<int> length(lengthSpan.first, lengthSpan.second - 1);
+        for (size_t i = first; i < last; ++i)
+            lengths[i] = static_cast<uint32_t>(length(mersenne));
+        streams[b] = mersenne;
+    });
+
+    std::vector<size_t> offsets(n + 1, 0);
+    for (size_t i = 0; i < n; ++i)
+        offsets[i + 1] = offsets[i] + lengths[i];
+    arena.bytes.resize(offsets[n]);
+    arena.views.resize(n);
+
+    parallelBlocks(n, block, [&](size_t b, size_t first, size_t last)
+    {
+        std::mt19937& mersenne = streams[b];
+        for (size_t i = first; i < last; ++i)
+        {
+            char* out = arena.bytes.data() + offsets[i];
+            for (uint32_t j = 0; j < lengths[i]; ++j)
+                out[j] = charSet[(static_cast<uint64_t>(mersenne()) * charCount) >> 32];
+            arena.views[i] = std::string_view(out, lengths[i]);
+        }
+    });
+}
+
+struct datasetHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t keyKind;
+    uint64_t seed;
+    uint64_t count;
+};
+
+inline datasetHeader makeDatasetHeader(uint32_t keyKind, uint64_t seed, uint64_t count)
+{
+    datasetHeader header;
+    std::memcpy(header.magic, "TREEDATA", 8);
+    header.version = 1;
+    header.keyKind = keyKind;
+    header.seed = seed;
+    header.count = count;
+    return header;
+}
+
+inline bool readDatasetHeader(std::ifstream& in, const datasetHeader& expected)
+{
+    datasetHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        return false;
+    return std::memcmp(header.magic, expected.magic, 8) == 0 && header.version == expected.version &&
+        header.keyKind == expected.keyKind && header.seed == expected.seed && header.count == expected.count;
+}
+
+inline bool saveDataset(const std::string& fileCache, uint64_t seed, const std::vector<int>& keys, const std::vector<int>& priority)
+{
+    std::ofstream out(fileCache, std::ios::binary);
+    datasetHeader header = makeDatasetHeader(0, seed, keys.size());
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(priority.data()), priority.size() * sizeof(int));
+    out.write(reinterpret_cast<const char*>(keys.data()), keys.size() * sizeof(int));
+    return static_cast<bool>(out);
+}
+
+inline bool loadDataset(const std::string& fileCache, uint64_t seed, size_t n, std::vector<int>& keys, std::vector<int>& priority)
+{
+    std::ifstream in(fileCache, std::ios::binary);
+    if (!in.is_open() || !readDatasetHeader(in, makeDatasetHeader(0, seed, n)))
+        return false;
+    priority.resize(n);
+    keys.resize(n);
+    in.read(reinterpret_cast<char*>(priority.data()), n * sizeof(int));
+    in.read(reinterpret_cast<char*>(keys.data()), n * sizeof(int));
+    return static_cast<bool>(in);
+}
+
+inline bool saveDataset(const std::string& fileCache, uint64_t seed, const stringArena& arena, const std::vector<int>& priority)
+{
+    std::ofstream out(fileCache, std::ios::binary);
+    datasetHeader header = makeDatasetHeader(1, seed, arena.views.size());
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(priority.data()), priority.size() * sizeof(int));
+    std::vector<uint32_t> lengths(arena.views.size());
+    for (size_t i = 0; i < lengths.size(); ++i)
+        lengths[i] = static_cast<uint32_t>(arena.views[i].size());
+    out.write(reinterpret_cast<const char*>(lengths.data()), lengths.size() * sizeof(uint32_t));
+    out.write(arena.bytes.data(), arena.bytes.size());
+    return static_cast<bool>(out);
+}
+
+inline bool loadDataset(const std::string& fileCache, uint64_t seed, size_t n, stringArena& arena, std::vector<int>& priority)
+{
+    std::ifstream in(fileCache, std::ios::binary);
+    if (!in.is_open() || !readDatasetHeader(in, makeDatasetHeader(1, seed, n)))
+        return false;
+    priority.resize(n);
+    in.read(reinterpret_cast<char*>(priority.data()), n * sizeof(int));
+    std::vector<uint32_t> lengths(n);
+    in.read(reinterpret_cast<char*>(lengths.data()), n * sizeof(uint32_t));
+    size_t total = 0;
+    for (size_t i = 0; i < n; ++i)
+        total += lengths[i];
+    arena.bytes.resize(total);
+    in.read(arena.bytes.data(), total);
+    if (!in)
+        return false;
+    arena.views.resize(n);
+    size_t offset = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        arena.views[i] = std::string_view(arena.bytes.data() + offset, lengths[i]);
+        offset += lengths[i];
+    }
+    return true;
+}
@@ -0,0 +1,141 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+enum hardwareCounter
+{
+    counterCycles,
+    counterInstructions,
+    counterL1Misses,
+    counterLlcMisses,
+    counterBranchMisses,
+    counterCount
+};
+
+inline const char* counterName(int counter)
+{
+    static const char* names[counterCount] = { "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses" };
+    return names[counter];
+}
+
+struct counterSample
+{
+    double values[counterCount];
+
+    counterSample()
+    {
+        for (int i = 0; i < counterCount; ++i)
+            values[i] = std::numeric_limits<double>::quiet_NaN();
+    }
+};
+
+class perfCounters
+{
+    int fds[counterCount];
+    bool opened;
+public:
+    struct reading
+    {
+        uint64_t value[counterCount];
+        uint64_t enabled[counterCount];
+        uint64_t running[counterCount];
+    };
+
+    perfCounters() : opened(false)
+    {
+        for (int i = 0; i < counterCount; ++i)
+            fds[i] = -1;
+    }
+
+    perfCounters(const perfCounters&) = delete;
+    perfCounters& operator=(const perfCounters&) = delete;
+
+    ~perfCounters()
+    {
+#ifdef __linux__
+        for (int i = 0; i < counterCount; ++i)
+        {
+            if (fds[i] >= 0)
+                close(fds[i]);
+        }
+#endif
+    }
+
+    bool open()
+    {
+#ifdef __linux__
+        const uint32_t types[counterCount] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE };
+        const uint64_t configs[counterCount] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+            PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+        for (int i = 0; i < counterCount; ++i)
+        {
+            if (fds[i] >= 0)
+                continue;
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = types[i];
+            attr.config = configs[i];
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            opened |= fds[i] >= 0;
+        }
+#endif
+        return opened;
+    }
+
+    bool active() const
+    {
+        return opened;
+    }
+
+    reading read() const
+    {
+        reading current;
+        std::memset(&current, 0, sizeof(current));
+#ifdef __linux__
+        for (int i = 0; i < counterCount && opened; ++i)
+        {
+            uint64_t buffer[3];
+            if (fds[i] >= 0 && ::read(fds[i], buffer, sizeof(buffer)) == sizeof(buffer))
+            {
+                current.value[i] = buffer[0];
+                current.enabled[i] = buffer[1];
+                current.running[i] = buffer[2];
+            }
+        }
+#endif
+        return current;
+    }
+
+    counterSample perOp(const reading& begin, const reading& end, size_t operations) const
+    {
+        counterSample sample;
+        for (int i = 0; i < counterCount; ++i)
+        {
+            uint64_t running = end.running[i] - begin.running[i];
+            if (fds[i] < 0 || running == 0)
+                continue;
+            double scale = static_cast<double>(end.enabled[i] - begin.enabled[i]) / running;
+            sample.values[i] = static_cast<double>(end.value[i] - begin.value[i]) * scale / (operations ? operations : 1);
+        }
+        return sample;
+    }
+};
+
+inline perfCounters& hardwareCounters()
+{
+    static perfCounters counters;
+    return counters;
+}
@@ -0,0 +1,194 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+enum workloadOperation
+{
+    opInsert,
+    opFind,
+    opErase
+};
+
+struct workloadOp
+{
+    workloadOperation operation;
+    size_t index;
+};
+
+struct workloadStream
+{
+    std::string label;
+    size_t prefill;
+    std::vector<workloadOp> ops;
+
+    workloadStream() : prefill(0) {}
+};
+
+class zipfGenerator
+{
+    std::vector<double> cdf;
+    std::vector<size_t> rank;
+    std::uniform_real_distribution<double> uniform;
+public:
+    zipfGenerator(std::mt19937& mersenne, size_t n, double exponent) : cdf(n), rank(n), uniform(0.0, 1.0)
+    {
+        double sum = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            sum += 1.0 / std::pow(static_cast<double>(i + 1), exponent);
+            cdf[i] = sum;
+        }
+        for (size_t i = 0; i < n; ++i)
+        {
+            cdf[i] /= sum;
+            rank[i] = i;
+        }
+        std::shuffle(rank.begin(), rank.end(), mersenne);
+    }
+
+    size_t operator()(std::mt19937& mersenne)
+    {
+        size_t i = std::lower_bound(cdf.begin(), cdf.end(), uniform(mersenne)) - cdf.begin();
+        return rank[std::min(i, rank.size() - 1)];
+    }
+};
+
+inline workloadStream makeZipfLookups(std::mt19937& mersenne, size_t n, size_t count, double exponent)
+{
+    workloadStream stream;
+    stream.label = "find";
+    stream.prefill = n;
+    zipfGenerator zipf(mersenne, n, exponent);
+    for (size_t i = 0; i < count; ++i)
+        stream.ops.push_back({ opFind, zipf(mersenne) });
+    return stream;
+}
+
+inline workloadStream makeHotSetLookups(std::mt19937& mersenne, size_t n, size_t count, double hotFraction, double hotProbability)
+{
+    workloadStream stream;
+    stream.label = "find";
+    stream.prefill = n;
+    size_t hot = std::max<size_t>(1, static_cast<size_t>(n * hotFraction));
+    std::vector<size_t> order(n);
+    for (size_t i = 0; i < n; ++i)
+        order[i] = i;
+    std::shuffle(order.begin(), order.end(), mersenne);
+    std::uniform_real_distribution<double> coin(0.0, 1.0);
+    std::uniform_int_distribution<size_t> hotIndex(0, hot - 1);
+    std::uniform_int_distribution<size_t> coldIndex(hot < n ? hot : 0, n - 1);
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t index = coin(mersenne) < hotProbability ? hotIndex(mersenne) : coldIndex(mersenne);
+        stream.ops.push_back({ opFind, order[index] });
+    }
+    return stream;
+}
+
+template <typename TypeKey>
+workloadStream makeSortedInserts(const std::vector<TypeKey>& keys, bool descending)
+{
+    workloadStream stream;
+    stream.label = "insert";
+    std::vector<size_t> order(keys.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&keys](size_t a, size_t b) { return keys[a] < keys[b]; });
+    if (descending)
+        std::reverse(order.begin(), order.end());
+    for (size_t i = 0; i < order.size(); ++i)
+        stream.ops.push_back({ opInsert, order[i] });
+    return stream;
+}
+
+inline workloadStream makeSlidingWindow(size_t n, size_t window)
+{
+    workloadStream stream;
+    stream.label = "window";
+    for (size_t i = 0; i < n; ++i)
+    {
+        stream.ops.push_back({ opInsert, i });
+        if (i >= window)
+            stream.ops.push_back({ opErase, i - window });
+    }
+    return stream;
+}
+
+inline workloadStream makeMix(std::mt19937& mersenne, size_t n, size_t count, double reads, double writes, double erases)
+{
+    workloadStream stream;
+    stream.label = "mixed";
+    stream.prefill = n / 2;
+    std::vector<size_t> live;
+    for (size_t i = 0; i < stream.prefill; ++i)
+        live.push_back(i);
+    size_t next = stream.prefill;
+    double total = reads + writes + erases;
+    if (total <= 0)
+    {
+        reads = 1;
+        total = 1;
+    }
+    std::uniform_real_distribution<double> coin(0.0, total);
+    for (size_t i = 0; i < count; ++i)
+    {
+        double pick = coin(mersenne);
+        if (pick < writes && next < n)
+        {
+            stream.ops.push_back({ opInsert, next });
+            live.push_back(next++);
+        }
+        else if (pick < writes + erases && !live.empty())
+        {
+            size_t j = std::uniform_int_distribution<size_t>(0, live.size() - 1)(mersenne);
+            stream.ops.push_back({ opErase, live[j] });
+            live[j] = live.back();
+            live.pop_back();
+        }
+        else if (!live.empty())
+        {
+            size_t j = std::uniform_int_distribution<size_t>(0, live.size() - 1)(mersenne);
+            stream.ops.push_back({ opFind, live[j] });
+        }
+    }
+    return stream;
+}
+
+template <typename TypeKey>
+bool readTrace(const std::string& fileTrace, std::vector<TypeKey>& keys, workloadStream& stream)
+{
+    std::ifstream in(fileTrace);
+    if (!in.is_open())
+        return false;
+    stream.label = "trace";
+    keys.clear();
+    std::map<TypeKey, size_t> indices;
+    std::string operation;
+    TypeKey key;
+    while (in >> operation >> key)
+    {
+        workloadOp op;
+        if (operation == "insert" || operation == "i")
+            op.operation = opInsert;
+        else if (operation == "find" || operation == "f")
+            op.operation = opFind;
+        else if (operation == "erase" || operation == "e")
+            op.operation = opErase;
+        else
+            return false;
+        auto found = indices.find(key);
+        if (found == indices.end())
+        {
+            found = indices.insert(std::make_pair(key, keys.size())).first;
+            keys.push_back(key);
+        }
+        op.index = found->second;
+        stream.ops.push_back(op);
+    }
+    return in.eof();
+}
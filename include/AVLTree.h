@@ -1,81 +1,128 @@
 #pragma once
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <type_traits>
 #include <vector>
+#include "NodePool.h"
+#include "TreeBatch.h"
+#include "ForkJoin.h"
+#include "TreeStats.h"
+#include "TreeIterator.h"
+#include "OrderStatistics.h"
+#include "KeyCompare.h"
+#include "TreeImage.h"
 
-template <typename TypeKey, typename TypeData>
-struct nodeAVL
+template <typename TypeKey, typename TypeData, typename TypeOrder = noOrderStatistics, typename TypeCompare = keyCompare>
+struct nodeAVL : TypeOrder::nodeAugment, TypeCompare::nodeCache
 {
 	TypeKey key;
 	TypeData data;
 
 	int height;
 
-	nodeAVL<TypeKey, TypeData>* left;
-	nodeAVL<TypeKey, TypeData>* right;
+	nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* left;
+	nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* right;
 
-	nodeAVL(const TypeKey &k, const TypeData &d) : key(k), data(d), left(0), right(0), height(1) {}
+	template <typename TypeK, typename... Args>
+	nodeAVL(TypeK&& k, Args&&... d) : key(std::forward<TypeK>(k)), data(std::forward<Args>(d)...), height(1), left(0), right(0)
+	{
+		this->cacheKey(key);
+		TypeOrder::update(this);
+	}
 };
 
-template <typename TypeKey, typename TypeData>
+template <typename TypeKey, typename TypeData, typename TypeAlloc = std::allocator<std::pair<const TypeKey, TypeData>>, typename TypeStats = noTreeStats, typename TypeOrder = noOrderStatistics, typename TypeCompare = keyCompare>
 class AVLTree
 {
-	nodeAVL<TypeKey, TypeData>* root;
-	int numInsert;
-	int numRemove;
-	int numFind;
+	typedef typename std::allocator_traits<TypeAlloc>::template rebind_alloc<nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>> TypeNodeAlloc;
+	typedef std::allocator_traits<TypeNodeAlloc> TypeNodeTraits;
+
+	TypeNodeAlloc alloc;
+	nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* root;
 	int numnodeAVL;
+	TypeStats stats;
+	TypeCompare compare;
+	bool iterative;
+
+	static const int maxHeight = 96;
+	static const size_t pathCapacity = 48;
+
+	typedef typename compareProbe<TypeCompare, TypeKey, TypeKey>::type TypeKeyProbe;
 
-	int height(nodeAVL<TypeKey, TypeData>* p)
+	template <typename TypeK, typename... Args>
+	nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* createNode(TypeK&& k, Args&&... d)
+	{
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p = TypeNodeTraits::allocate(alloc, 1);
+		try
+		{
+			TypeNodeTraits::construct(alloc, p, std::forward<TypeK>(k), std::forward<Args>(d)...);
+		}
+		catch (...)
+		{
+			TypeNodeTraits::deallocate(alloc, p, 1);
+			throw;
+		}
+		return p;
+	}
+
+	void destroyNode(nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p)
+	{
+		TypeNodeTraits::destroy(alloc, p);
+		TypeNodeTraits::deallocate(alloc, p, 1);
+	}
+
+	int height(nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p)
 	{
 		return p ? p->height : 0;
 	}
 
-	int balanceFactor(nodeAVL<TypeKey, TypeData>* p)
+	int balanceFactor(nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p)
 	{
 		return height(p->right) - height(p->left);
 	}
 
-	void fixHeight(nodeAVL<TypeKey, TypeData>* p)
+	void fixHeight(nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p)
 	{
 		int hl = height(p->left);
 		int hr = height(p->right);
 		p->height = (hl > hr ? hl : hr) + 1;
+		TypeOrder::update(p);
 	}
 
-	nodeAVL<TypeKey, TypeData>* rotateRight(nodeAVL<TypeKey, TypeData>* p)
+	nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* rotateRight(nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p)
 	{
-		nodeAVL<TypeKey, TypeData>* q = p->left;
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* q = p->left;
 		p->left = q->right;
 		q->right = p;
+		stats.rotate();
 		fixHeight(p);
 		fixHeight(q);
 		return q;
 	}
 
-	nodeAVL<TypeKey, TypeData>* rotateLeft(nodeAVL<TypeKey, TypeData>* q)
+	nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* rotateLeft(nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* q)
 	{
-		nodeAVL<TypeKey, TypeData>* p = q->right;
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p = q->right;
 		q->right = p->left;
 		p->left = q;
+		stats.rotate();
 		fixHeight(q);
 		fixHeight(p);
 		return p;
 	}
 
-	nodeAVL<TypeKey, TypeData>* balance(nodeAVL<TypeKey, TypeData>* p)
+	nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* rebalance(nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p)
 	{
 		fixHeight(p);
 		if (balanceFactor(p) == 2)
 		{
-			numInsert++;
-			numRemove++;
 			if (balanceFactor(p->right) < 0)
 				p->right = rotateRight(p->right);
 			return rotateLeft(p);
 		}
 		if (balanceFactor(p) == -2)
 		{
-			numInsert++;
-			numRemove++;
 			if (balanceFactor(p->left) > 0)
 				p->left = rotateLeft(p->left);
 			return rotateRight(p);
@@ -83,12 +130,18 @@ class AVLTree
 		return p;
 	}
 
-	nodeAVL<TypeKey, TypeData>* findMin(nodeAVL<TypeKey, TypeData>* p)
+	nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* balance(nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p)
+	{
+		stats.restructure();
+		return rebalance(p);
+	}
+
+	nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* findMin(nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p)
 	{
 		return p->left ? findMin(p->left) : p;
 	}
 
-	nodeAVL<TypeKey, TypeData>* removeMin(nodeAVL<TypeKey, TypeData>* p)
+	nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* removeMin(nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p)
 	{
 		if (p->left == 0)
 			return p->right;
@@ -96,48 +149,45 @@ class AVLTree
 		return balance(p);
 	}
 
-	nodeAVL<TypeKey, TypeData>* insertElement(nodeAVL<TypeKey, TypeData>* p, const TypeKey &k, const TypeData &d)
+	template <typename TypeProbe, typename TypeK, typename... Args>
+	nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* insertElement(nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p, bool unique, bool& inserted, const TypeProbe& q, TypeK&& k, Args&&... d)
 	{
 		if (!p)
 		{
+			p = createNode(std::forward<TypeK>(k), std::forward<Args>(d)...);
 			numnodeAVL++;
-			return new nodeAVL<TypeKey, TypeData>(k, d);
-		}
-		if (k < p->key)
-		{
-			numInsert++;
-			p->left = insertElement(p->left, k, d);
+			inserted = true;
+			return p;
 		}
+		stats.compare();
+		int c = compare(q, p);
+		if (unique && c == 0)
+			return p;
+		if (c < 0)
+			p->left = insertElement(p->left, unique, inserted, q, std::forward<TypeK>(k), std::forward<Args>(d)...);
 		else
-		{
-			numInsert++;
-			p->right = insertElement(p->right, k, d);
-		}
-		return balance(p);
+			p->right = insertElement(p->right, unique, inserted, q, std::forward<TypeK>(k), std::forward<Args>(d)...);
+		return inserted ? balance(p) : p;
 	}
 
-	nodeAVL<TypeKey, TypeData>* removeElement(nodeAVL<TypeKey, TypeData>* p, const TypeKey &k)
+	template <typename TypeProbe>
+	nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* removeElement(nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p, const TypeProbe &k)
 	{
 		if (!p) return 0;
-		if (k < p->key)
-		{
-			numRemove++;
+		stats.compare();
+		int c = compare(k, p);
+		if (c < 0)
 			p->left = removeElement(p->left, k);
-		}
-		else if (k > p->key)
-		{
-			numRemove++;
+		else if (c > 0)
 			p->right = removeElement(p->right, k);
-		}
 		else
 		{
-			numRemove++;
-			nodeAVL<TypeKey, TypeData>* q = p->left;
-			nodeAVL<TypeKey, TypeData>* r = p->right;
+			nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* q = p->left;
+			nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* r = p->right;
 			numnodeAVL--;
-			delete p;
+			destroyNode(p);
 			if (!r) return q;
-			nodeAVL<TypeKey, TypeData>* min = findMin(r);
+			nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* min = findMin(r);
 			min->right = removeMin(r);
 			min->left = q;
 			return balance(min);
@@ -145,73 +195,695 @@ class AVLTree
 		return balance(p);
 	}
 
-	TypeData findElement(nodeAVL<TypeKey, TypeData>* p, const TypeKey &k)
+	template <typename TypeProbe>
+	nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* findElement(nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p, const TypeProbe &k)
 	{
 		if (!p) return 0;
-		if (k == p->key)
+		stats.compare();
+		int c = compare(k, p);
+		if (c == 0)
+			return p;
+		return findElement(c < 0 ? p->left : p->right, k);
+	}
+
+	template <typename TypeProbe, typename TypeK, typename... Args>
+	bool insertIterative(bool unique, const TypeProbe& q, TypeK&& k, Args&&... d)
+	{
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>** path[maxHeight];
+		int depth = 0;
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>** link = &root;
+		while (*link)
+		{
+			stats.compare();
+			int c = compare(q, *link);
+			if (unique && c == 0) return false;
+			path[depth++] = link;
+			link = c < 0 ? &(*link)->left : &(*link)->right;
+		}
+		*link = createNode(std::forward<TypeK>(k), std::forward<Args>(d)...);
+		numnodeAVL++;
+		while (depth > 0)
 		{
-			numFind++;
-			return p->data;
+			link = path[--depth];
+			int h = (*link)->height;
+			*link = balance(*link);
+			if ((*link)->height == h && !TypeOrder::enabled) break;
+		}
+		return true;
+	}
+
+	template <typename TypeProbe>
+	void removeIterative(const TypeProbe &k)
+	{
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>** path[maxHeight];
+		int depth = 0;
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>** link = &root;
+		while (*link)
+		{
+			stats.compare();
+			int c = compare(k, *link);
+			if (c == 0)
+				break;
+			path[depth++] = link;
+			link = c < 0 ? &(*link)->left : &(*link)->right;
+		}
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p = *link;
+		if (!p) return;
+		numnodeAVL--;
+		if (!p->right)
+		{
+			*link = p->left;
 		}
 		else
 		{
-			if (k < p->key)
+			path[depth++] = link;
+			int first = depth;
+			nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>** minLink = &p->right;
+			while ((*minLink)->left)
 			{
-				numFind++;
-				return findElement(p->left, k);
-			}
-			else
-			{
-				numFind++;
-				return findElement(p->right, k);
+				path[depth++] = minLink;
+				minLink = &(*minLink)->left;
 			}
+			nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* min = *minLink;
+			*minLink = min->right;
+			min->left = p->left;
+			min->right = p->right;
+			min->height = p->height;
+			*link = min;
+			if (first < depth) path[first] = &min->right;
+		}
+		destroyNode(p);
+		while (depth > 0)
+		{
+			link = path[--depth];
+			int h = (*link)->height;
+			*link = balance(*link);
+			if ((*link)->height == h && !TypeOrder::enabled) break;
+		}
+	}
+
+	template <typename TypeProbe>
+	nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* findIterative(const TypeProbe &k)
+	{
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p = root;
+		while (p)
+		{
+			stats.compare();
+			int c = compare(k, p);
+			if (c == 0) return p;
+			p = c < 0 ? p->left : p->right;
+		}
+		return 0;
+	}
+
+	template <typename Iterator>
+	nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* buildElement(Iterator& it, size_t n)
+	{
+		if (n == 0) return 0;
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* left = buildElement(it, n / 2);
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p = createNode(it->first, it->second);
+		++it;
+		p->left = left;
+		p->right = buildElement(it, n - n / 2 - 1);
+		fixHeight(p);
+		return p;
+	}
+
+	nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* join(nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* l, nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* k, nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* r)
+	{
+		if (height(l) > height(r) + 1)
+		{
+			l->right = join(l->right, k, r);
+			return rebalance(l);
+		}
+		if (height(r) > height(l) + 1)
+		{
+			r->left = join(l, k, r->left);
+			return rebalance(r);
+		}
+		k->left = l;
+		k->right = r;
+		fixHeight(k);
+		return k;
+	}
+
+	nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* extractMin(nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p, nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>*& min)
+	{
+		if (!p->left)
+		{
+			min = p;
+			return p->right;
 		}
+		p->left = extractMin(p->left, min);
+		return rebalance(p);
 	}
 
-	void clearElement(nodeAVL<TypeKey, TypeData>* p)
+	nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* joinTwo(nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* l, nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* r)
+	{
+		if (!r) return l;
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* min = 0;
+		r = extractMin(r, min);
+		return join(l, min, r);
+	}
+
+	void splitElement(nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p, const TypeKeyProbe &k,
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>*& left, nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>*& equal, nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>*& right)
+	{
+		if (!p)
+		{
+			left = 0;
+			equal = 0;
+			right = 0;
+			return;
+		}
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* l = p->left;
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* r = p->right;
+		int c = compare(k, p);
+		if (c < 0)
+		{
+			splitElement(l, k, left, equal, l);
+			right = join(l, p, r);
+		}
+		else if (c > 0)
+		{
+			splitElement(r, k, r, equal, right);
+			left = join(l, p, r);
+		}
+		else
+		{
+			left = l;
+			right = r;
+			equal = p;
+			p->left = 0;
+			p->right = 0;
+			fixHeight(p);
+		}
+	}
+
+	void collectElement(nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p, std::vector<nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>*>& dropped)
 	{
 		if (!p) return;
-		nodeAVL<TypeKey, TypeData>* q = p->left;
-		nodeAVL<TypeKey, TypeData>* r = p->right;
-		delete p;
-		if (!q) clearElement(q);
-		if (!r) clearElement(r);
+		size_t i = dropped.size();
+		dropped.push_back(p);
+		for (; i < dropped.size(); ++i)
+		{
+			if (dropped[i]->left) dropped.push_back(dropped[i]->left);
+			if (dropped[i]->right) dropped.push_back(dropped[i]->right);
+		}
+	}
+
+	nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* uniteElement(nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p, nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* q,
+		std::vector<nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>*>& dropped, size_t size, int forks)
+	{
+		if (!p) return q;
+		if (!q) return p;
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* l;
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* equal;
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* r;
+		splitElement(q, TypeKeyProbe(p->key), l, equal, r);
+		if (equal) dropped.push_back(equal);
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* left = p->left;
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* right = p->right;
+		std::vector<nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>*> droppedLeft;
+		bool parallel = forks > 0 && size >= forkCutoff;
+		forkJoin(parallel,
+			[&] { left = uniteElement(left, l, parallel ? droppedLeft : dropped, size / 2, forks - 1); },
+			[&] { right = uniteElement(right, r, dropped, size / 2, forks - 1); });
+		dropped.insert(dropped.end(), droppedLeft.begin(), droppedLeft.end());
+		return join(left, p, right);
+	}
+
+	nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* intersectElement(nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p, nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* q,
+		std::vector<nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>*>& dropped, size_t size, int forks)
+	{
+		if (!p || !q)
+		{
+			collectElement(p, dropped);
+			collectElement(q, dropped);
+			return 0;
+		}
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* l;
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* equal;
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* r;
+		splitElement(q, TypeKeyProbe(p->key), l, equal, r);
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* left = p->left;
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* right = p->right;
+		std::vector<nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>*> droppedLeft;
+		bool parallel = forks > 0 && size >= forkCutoff;
+		forkJoin(parallel,
+			[&] { left = intersectElement(left, l, parallel ? droppedLeft : dropped, size / 2, forks - 1); },
+			[&] { right = intersectElement(right, r, dropped, size / 2, forks - 1); });
+		dropped.insert(dropped.end(), droppedLeft.begin(), droppedLeft.end());
+		if (equal)
+		{
+			dropped.push_back(equal);
+			return join(left, p, right);
+		}
+		dropped.push_back(p);
+		return joinTwo(left, right);
+	}
+
+	nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* differenceElement(nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p, nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* q,
+		std::vector<nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>*>& dropped, size_t size, int forks)
+	{
+		if (!p)
+		{
+			collectElement(q, dropped);
+			return 0;
+		}
+		if (!q) return p;
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* l;
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* equal;
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* r;
+		splitElement(p, TypeKeyProbe(q->key), l, equal, r);
+		if (equal) dropped.push_back(equal);
+		dropped.push_back(q);
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* left = q->left;
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* right = q->right;
+		std::vector<nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>*> droppedLeft;
+		bool parallel = forks > 0 && size >= forkCutoff;
+		forkJoin(parallel,
+			[&] { left = differenceElement(l, left, parallel ? droppedLeft : dropped, size / 2, forks - 1); },
+			[&] { right = differenceElement(r, right, dropped, size / 2, forks - 1); });
+		dropped.insert(dropped.end(), droppedLeft.begin(), droppedLeft.end());
+		return joinTwo(left, right);
+	}
+
+	nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* copyElement(nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p)
+	{
+		if (!p) return 0;
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* q = createNode(p->key, p->data);
+		q->left = copyElement(p->left);
+		q->right = copyElement(p->right);
+		fixHeight(q);
+		return q;
+	}
+
+	nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* takeElements(AVLTree& other)
+	{
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* q;
+		if (alloc == other.alloc)
+		{
+			q = other.root;
+			other.root = 0;
+			other.numnodeAVL = 0;
+		}
+		else
+		{
+			q = copyElement(other.root);
+			other.clear();
+		}
+		return q;
+	}
+
+	static int forkBudget()
+	{
+		return TypeStats::enabled ? 0 : forkDepth();
+	}
+
+	template <typename Operation>
+	void setOperation(AVLTree& other, Operation operation)
+	{
+		if (&other == this) return;
+		stats.begin(treeBulk);
+		size_t size = numnodeAVL + other.numnodeAVL;
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* q = takeElements(other);
+		std::vector<nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>*> dropped;
+		root = (this->*operation)(root, q, dropped, size, forkBudget());
+		for (size_t i = 0; i < dropped.size(); ++i)
+			destroyNode(dropped[i]);
+		numnodeAVL = static_cast<int>(size - dropped.size());
+	}
+
+	template <typename Iterator>
+	nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* insertBatch(nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p, Iterator first, Iterator last)
+	{
+		if (first == last) return p;
+		if (!p)
+		{
+			size_t n = last - first;
+			numnodeAVL += static_cast<int>(n);
+			return buildElement(first, n);
+		}
+		Iterator mid = std::lower_bound(first, last, p->key,
+			[this](const std::pair<TypeKey, TypeData>& a, const TypeKey& k) { return compare(a.first, k) < 0; });
+		Iterator midEnd = mid;
+		if (midEnd != last && compare(p->key, midEnd->first) >= 0)
+		{
+			p->data = midEnd->second;
+			++midEnd;
+		}
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* l = insertBatch(p->left, first, mid);
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* r = insertBatch(p->right, midEnd, last);
+		return join(l, p, r);
+	}
+
+	template <typename Iterator>
+	nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* removeBatch(nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p, Iterator first, Iterator last)
+	{
+		if (first == last || !p) return p;
+		Iterator mid = std::lower_bound(first, last, p->key,
+			[this](const TypeKey& a, const TypeKey& k) { return compare(a, k) < 0; });
+		bool hit = mid != last && compare(p->key, *mid) >= 0;
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* l = removeBatch(p->left, first, mid);
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* r = removeBatch(p->right, hit ? mid + 1 : mid, last);
+		if (hit)
+		{
+			numnodeAVL--;
+			destroyNode(p);
+			return joinTwo(l, r);
+		}
+		return join(l, p, r);
+	}
+
+	template <typename Iterator>
+	void findBatch(nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p, Iterator first, Iterator last,
+		const std::vector<TypeKey>& keys, std::vector<TypeData>& result)
+	{
+		if (first == last || !p) return;
+		Iterator mid = std::lower_bound(first, last, p->key,
+			[this, &keys](size_t i, const TypeKey& k) { return compare(keys[i], k) < 0; });
+		Iterator midEnd = mid;
+		while (midEnd != last && compare(p->key, keys[*midEnd]) >= 0)
+		{
+			result[*midEnd] = p->data;
+			++midEnd;
+		}
+		findBatch(p->left, first, mid, keys, result);
+		findBatch(p->right, midEnd, last, keys, result);
+	}
+
+	void clearElement(nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p)
+	{
+		std::vector<nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>*> stack;
+		if (p) stack.push_back(p);
+		while (!stack.empty())
+		{
+			p = stack.back();
+			stack.pop_back();
+			if (p->left) stack.push_back(p->left);
+			if (p->right) stack.push_back(p->right);
+			destroyNode(p);
+		}
 	}
 public:
-	AVLTree() : root(0), numInsert(0), numRemove(0), numFind(0), numnodeAVL(0) {}
+	explicit AVLTree(const TypeAlloc& alloc_ = TypeAlloc(), const TypeCompare& compare_ = TypeCompare()) : alloc(alloc_), root(0), numnodeAVL(0), compare(compare_), iterative(true) {}
 	~AVLTree() { clear(); }
 
 	void insert(const std::pair<TypeKey, TypeData> &value)
 	{
-		numInsert = 0;
-		root = insertElement(root, value.first, value.second);
+		emplace(value.first, value.second);
+	}
+
+	void insert(std::pair<TypeKey, TypeData> &&value)
+	{
+		emplace(std::move(value.first), std::move(value.second));
+	}
+
+	template <typename TypeK, typename... Args>
+	void emplace(TypeK&& key, Args&&... data)
+	{
+		stats.begin(treeInsert);
+		typename compareProbe<TypeCompare, TypeKey, TypeK>::type q(key);
+		if (iterative)
+			insertIterative(false, q, std::forward<TypeK>(key), std::forward<Args>(data)...);
+		else
+		{
+			bool inserted = false;
+			root = insertElement(root, false, inserted, q, std::forward<TypeK>(key), std::forward<Args>(data)...);
+		}
+	}
+
+	template <typename TypeK, typename... Args>
+	bool try_emplace(TypeK&& key, Args&&... data)
+	{
+		stats.begin(treeInsert);
+		typename compareProbe<TypeCompare, TypeKey, TypeK>::type q(key);
+		if (iterative)
+			return insertIterative(true, q, std::forward<TypeK>(key), std::forward<Args>(data)...);
+		bool inserted = false;
+		root = insertElement(root, true, inserted, q, std::forward<TypeK>(key), std::forward<Args>(data)...);
+		return inserted;
+	}
+
+	template <typename TypeLookup>
+	void erase(const TypeLookup &key)
+	{
+		stats.begin(treeErase);
+		typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type q(key);
+		if (iterative)
+			removeIterative(q);
+		else
+			root = removeElement(root, q);
+	}
+
+	template <typename TypeLookup>
+	TypeData find(const TypeLookup &key)
+	{
+		stats.begin(treeFind);
+		typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type q(key);
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p = iterative ? findIterative(q) : findElement(root, q);
+		return p ? p->data : TypeData();
+	}
+
+	template <typename TypeLookup>
+	bool contains(const TypeLookup &key)
+	{
+		stats.begin(treeFind);
+		typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type q(key);
+		return (iterative ? findIterative(q) : findElement(root, q)) != 0;
+	}
+
+	void setIterative(bool value)
+	{
+		iterative = value;
+	}
+
+	bool isIterative() const
+	{
+		return iterative;
+	}
+
+	template <typename Func>
+	void for_each(Func func) const
+	{
+		std::vector<nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>*> stack;
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p = root;
+		while (p || !stack.empty())
+		{
+			while (p)
+			{
+				stack.push_back(p);
+				p = p->left;
+			}
+			p = stack.back();
+			stack.pop_back();
+			func(p->key, p->data);
+			p = p->right;
+		}
+	}
+
+	typedef pathIterator<nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>, TypeKey, TypeData, pathCapacity> iterator;
+	typedef pathIterator<nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>, TypeKey, const TypeData, pathCapacity> const_iterator;
+
+	iterator begin()
+	{
+		return iterator::first(&root);
+	}
+
+	iterator end()
+	{
+		return iterator(&root);
+	}
+
+	const_iterator begin() const
+	{
+		return const_iterator::first(&root);
+	}
+
+	const_iterator end() const
+	{
+		return const_iterator(&root);
 	}
 
-	void erase(const TypeKey &key)
+	template <typename TypeLookup>
+	iterator lower_bound(const TypeLookup& key)
 	{
-		numRemove = 0;
-		root = removeElement(root, key);
+		typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type q(key);
+		return iterator::bound(&root, [this, &q](const nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p) { return compare(q, p) > 0; });
 	}
 
-	TypeData find(const TypeKey &key)
+	template <typename TypeLookup>
+	iterator upper_bound(const TypeLookup& key)
 	{
-		numFind = 0;
-		return findElement(root, key);
+		typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type q(key);
+		return iterator::bound(&root, [this, &q](const nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p) { return compare(q, p) >= 0; });
 	}
 
-	int getLastNumInsert() const
+	template <typename TypeLookup>
+	const_iterator lower_bound(const TypeLookup& key) const
 	{
-		return numInsert;
+		typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type q(key);
+		return const_iterator::bound(&root, [this, &q](const nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p) { return compare(q, p) > 0; });
 	}
 
-	int getLastNumRemove() const
+	template <typename TypeLookup>
+	const_iterator upper_bound(const TypeLookup& key) const
 	{
-		return numRemove;
+		typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type q(key);
+		return const_iterator::bound(&root, [this, &q](const nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p) { return compare(q, p) >= 0; });
 	}
 
-	int getLastNumFind() const
+	template <typename TypeLookup>
+	std::pair<iterator, iterator> equal_range(const TypeLookup& key)
 	{
-		return numFind;
+		return std::make_pair(lower_bound(key), upper_bound(key));
+	}
+
+	template <typename TypeLookup>
+	std::pair<const_iterator, const_iterator> equal_range(const TypeLookup& key) const
+	{
+		return std::make_pair(lower_bound(key), upper_bound(key));
+	}
+
+	template <typename TypeLookup>
+	size_t rank(const TypeLookup& key) const
+	{
+		static_assert(TypeOrder::enabled, "rank needs orderStatistics");
+		typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type q(key);
+		return rankElement<TypeOrder>(root, compare, q);
+	}
+
+	iterator select(size_t k)
+	{
+		static_assert(TypeOrder::enabled, "select needs orderStatistics");
+		return selectElement<TypeOrder, iterator>(&root, k);
+	}
+
+	const_iterator select(size_t k) const
+	{
+		static_assert(TypeOrder::enabled, "select needs orderStatistics");
+		return selectElement<TypeOrder, const_iterator>(&root, k);
+	}
+
+	template <typename TypeLookup>
+	size_t count_range(const TypeLookup& lo, const TypeLookup& hi) const
+	{
+		size_t first = rank(lo);
+		size_t last = rank(hi);
+		return last > first ? last - first : 0;
+	}
+
+	template <typename TypeLookup, typename Func>
+	void for_each_in_range(const TypeLookup& lo, const TypeLookup& hi, Func func) const
+	{
+		for (const_iterator it = lower_bound(lo), last = end(); it != last; ++it)
+		{
+			typename const_iterator::reference value = *it;
+			if (compare(value.first, hi) >= 0) break;
+			func(value.first, value.second);
+		}
+	}
+
+	template <typename TypeLookup, typename TypeAggregate = TypeOrder>
+	typename TypeAggregate::value_type aggregate(const TypeLookup& lo, const TypeLookup& hi) const
+	{
+		typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type qlo(lo);
+		typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type qhi(hi);
+		return aggregateElement<TypeAggregate>(root, compare, qlo, qhi);
+	}
+
+	template <typename TypeLookup, typename Func>
+	bool update(const TypeLookup& key, Func func)
+	{
+		stats.begin(treeFind);
+		typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type q(key);
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* path[maxHeight];
+		int depth = 0;
+		nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>* p = root;
+		while (p)
+		{
+			stats.compare();
+			int c = compare(q, p);
+			path[depth++] = p;
+			if (c == 0) break;
+			p = c < 0 ? p->left : p->right;
+		}
+		if (!p) return false;
+		func(p->data);
+		while (depth > 0)
+			TypeOrder::update(path[--depth]);
+		return true;
+	}
+
+	template <typename Iterator>
+	void build(Iterator first, Iterator last)
+	{
+		clear();
+		stats.begin(treeBulk);
+		size_t n = std::distance(first, last);
+		root = buildElement(first, n);
+		numnodeAVL = static_cast<int>(n);
+	}
+
+	void build(std::vector<std::pair<TypeKey, TypeData>> elements)
+	{
+		std::stable_sort(elements.begin(), elements.end(),
+			[this](const std::pair<TypeKey, TypeData>& a, const std::pair<TypeKey, TypeData>& b) { return compare(a.first, b.first) < 0; });
+		build(elements.begin(), elements.end());
+	}
+
+	bool save(const std::string& path) const
+	{
+		treeImageWriter<TypeKey, TypeData> image(numnodeAVL);
+		for_each([&image](const TypeKey& key, const TypeData& data) { image.add(key, data); });
+		return image.write(path);
+	}
+
+	bool load(const std::string& path)
+	{
+		treeImageView<TypeKey, TypeData, TypeCompare> image(compare);
+		if (!image.open(path)) return false;
+		build(image.begin(), image.end());
+		return true;
+	}
+
+	void insert_batch(std::vector<std::pair<TypeKey, TypeData>> batch)
+	{
+		stats.begin(treeBulk);
+		prepareBatch(batch, compare);
+		root = insertBatch(root, batch.begin(), batch.end());
+	}
+
+	void erase_batch(std::vector<TypeKey> keys)
+	{
+		stats.begin(treeBulk);
+		prepareBatch(keys, compare);
+		root = removeBatch(root, keys.begin(), keys.end());
+	}
+
+	std::vector<TypeData> find_batch(const std::vector<TypeKey>& keys)
+	{
+		stats.begin(treeBulk);
+		std::vector<TypeData> result(keys.size());
+		std::vector<size_t> order = orderBatch(keys, compare);
+		findBatch(root, order.begin(), order.end(), keys, result);
+		return result;
+	}
+
+	void unite(AVLTree& other)
+	{
+		setOperation(other, &AVLTree::uniteElement);
+	}
+
+	void intersect(AVLTree& other)
+	{
+		setOperation(other, &AVLTree::intersectElement);
+	}
+
+	void difference(AVLTree& other)
+	{
+		setOperation(other, &AVLTree::differenceElement);
 	}
 
 	int getNumnodeAVL() const
@@ -219,9 +891,24 @@ public:
 		return numnodeAVL;
 	}
 
+	const TypeStats& getStats() const
+	{
+		return stats;
+	}
+
+	treeShape getShape() const
+	{
+		return measureShape(root);
+	}
+
 	void clear()
 	{
-		clearElement(root);
+		bool bulk = allocatorRelease<TypeNodeAlloc>::exclusive(alloc);
+		if (!bulk || !std::is_trivially_destructible<nodeAVL<TypeKey, TypeData, TypeOrder, TypeCompare>>::value)
+			clearElement(root);
+		if (bulk)
+			allocatorRelease<TypeNodeAlloc>::release(alloc);
 		root = 0;
+		numnodeAVL = 0;
 	}
 };
\ No newline at end of file
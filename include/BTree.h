@@ -0,0 +1,356 @@
+#pragma once
+#include <algorithm>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "NodePool.h"
+#include "SimdSearch.h"
+
+template <typename TypeKey>
+struct degreeBTree
+{
+    static const int bytesKeys = 256;
+    static const int value = (bytesKeys / sizeof(TypeKey) + 1) / 2 < 2 ? 2 : (bytesKeys / sizeof(TypeKey) + 1) / 2;
+};
+
+template <typename TypeKey, typename TypeData, int Degree>
+struct nodeBTree
+{
+    int count;
+    bool leaf;
+    TypeKey keys[2 * Degree - 1];
+    TypeData data[2 * Degree - 1];
+    nodeBTree<TypeKey, TypeData, Degree>* children[2 * Degree];
+
+    explicit nodeBTree(bool leaf_) : count(0), leaf(leaf_) {}
+};
+
+template <typename TypeKey, typename TypeData, int Degree = degreeBTree<TypeKey>::value,
+    typename TypeAlloc = std::allocator<std::pair<const TypeKey, TypeData>>>
+class BTree
+{
+    static_assert(Degree >= 2, "BTree degree must be at least 2");
+
+    typedef nodeBTree<TypeKey, TypeData, Degree> TypeNode;
+    typedef typename std::allocator_traits<TypeAlloc>::template rebind_alloc<TypeNode> TypeNodeAlloc;
+    typedef std::allocator_traits<TypeNodeAlloc> TypeNodeTraits;
+
+    static const int maxKeys = 2 * Degree - 1;
+    static const int minKeys = Degree - 1;
+
+    TypeNodeAlloc alloc;
+    TypeNode* root;
+    size_t numElements;
+
+    TypeNode* createNode(bool leaf)
+    {
+        TypeNode* p = TypeNodeTraits::allocate(alloc, 1);
+        try
+        {
+            TypeNodeTraits::construct(alloc, p, leaf);
+        }
+        catch (...)
+        {
+            TypeNodeTraits::deallocate(alloc, p, 1);
+            throw;
+        }
+        return p;
+    }
+
+    void destroyNode(TypeNode* p)
+    {
+        TypeNodeTraits::destroy(alloc, p);
+        TypeNodeTraits::deallocate(alloc, p, 1);
+    }
+
+    int findIndex(const TypeNode* p, const TypeKey& key) const
+    {
+        return keySearch<TypeKey>::lowerBound(p->keys, p->count, key);
+    }
+
+    void splitChild(TypeNode* p, int i)
+    {
+        TypeNode* y = p->children[i];
+        TypeNode* z = createNode(y->leaf);
+        z->count = minKeys;
+        for (int j = 0; j < minKeys; ++j)
+        {
+            z->keys[j] = std::move(y->keys[j + Degree]);
+            z->data[j] = std::move(y->data[j + Degree]);
+        }
+        if (!y->leaf)
+        {
+            for (int j = 0; j < Degree; ++j)
+                z->children[j] = y->children[j + Degree];
+        }
+        y->count = minKeys;
+        for (int j = p->count; j > i; --j)
+            p->children[j + 1] = p->children[j];
+        p->children[i + 1] = z;
+        for (int j = p->count; j > i; --j)
+        {
+            p->keys[j] = std::move(p->keys[j - 1]);
+            p->data[j] = std::move(p->data[j - 1]);
+        }
+        p->keys[i] = std::move(y->keys[minKeys]);
+        p->data[i] = std::move(y->data[minKeys]);
+        p->count++;
+    }
+
+    void insertNonFull(TypeNode* p, const TypeKey& key, const TypeData& value)
+    {
+        for (;;)
+        {
+            int i = findIndex(p, key);
+            if (i < p->count && !(key < p->keys[i]))
+            {
+                p->data[i] = value;
+                return;
+            }
+            if (p->leaf)
+            {
+                for (int j = p->count; j > i; --j)
+                {
+                    p->keys[j] = std::move(p->keys[j - 1]);
+                    p->data[j] = std::move(p->data[j - 1]);
+                }
+                p->keys[i] = key;
+                p->data[i] = value;
+                p->count++;
+                numElements++;
+                return;
+            }
+            if (p->children[i]->count == maxKeys)
+            {
+                splitChild(p, i);
+                if (p->keys[i] < key)
+                    i++;
+                else if (!(key < p->keys[i]))
+                {
+                    p->data[i] = value;
+                    return;
+                }
+            }
+            p = p->children[i];
+        }
+    }
+
+    void removeFromLeaf(TypeNode* p, int i)
+    {
+        for (int j = i + 1; j < p->count; ++j)
+        {
+            p->keys[j - 1] = std::move(p->keys[j]);
+            p->data[j - 1] = std::move(p->data[j]);
+        }
+        p->count--;
+    }
+
+    void mergeChildren(TypeNode* p, int i)
+    {
+        TypeNode* y = p->children[i];
+        TypeNode* z = p->children[i + 1];
+        y->keys[minKeys] = std::move(p->keys[i]);
+        y->data[minKeys] = std::move(p->data[i]);
+        for (int j = 0; j < z->count; ++j)
+        {
+            y->keys[j + Degree] = std::move(z->keys[j]);
+            y->data[j + Degree] = std::move(z->data[j]);
+        }
+        if (!y->leaf)
+        {
+            for (int j = 0; j <= z->count; ++j)
+                y->children[j + Degree] = z->children[j];
+        }
+        y->count += z->count + 1;
+        for (int j = i + 1; j < p->count; ++j)
+        {
+            p->keys[j - 1] = std::move(p->keys[j]);
+            p->data[j - 1] = std::move(p->data[j]);
+        }
+        for (int j = i + 2; j <= p->count; ++j)
+            p->children[j - 1] = p->children[j];
+        p->count--;
+        destroyNode(z);
+    }
+
+    void borrowFromPrev(TypeNode* p, int i)
+    {
+        TypeNode* child = p->children[i];
+        TypeNode* sibling = p->children[i - 1];
+        for (int j = child->count; j > 0; --j)
+        {
+            child->keys[j] = std::move(child->keys[j - 1]);
+            child->data[j] = std::move(child->data[j - 1]);
+        }
+        if (!child->leaf)
+        {
+            for (int j = child->count + 1; j > 0; --j)
+                child->children[j] = child->children[j - 1];
+            child->children[0] = sibling->children[sibling->count];
+        }
+        child->keys[0] = std::move(p->keys[i - 1]);
+        child->data[0] = std::move(p->data[i - 1]);
+        p->keys[i - 1] = std::move(sibling->keys[sibling->count - 1]);
+        p->data[i - 1] = std::move(sibling->data[sibling->count - 1]);
+        child->count++;
+        sibling->count--;
+    }
+
+    void borrowFromNext(TypeNode* p, int i)
+    {
+        TypeNode* child = p->children[i];
+        TypeNode* sibling = p->children[i + 1];
+        child->keys[child->count] = std::move(p->keys[i]);
+        child->data[child->count] = std::move(p->data[i]);
+        if (!child->leaf)
+            child->children[child->count + 1] = sibling->children[0];
+        p->keys[i] = std::move(sibling->keys[0]);
+        p->data[i] = std::move(sibling->data[0]);
+        for (int j = 1; j < sibling->count; ++j)
+        {
+            sibling->keys[j - 1] = std::move(sibling->keys[j]);
+            sibling->data[j - 1] = std::move(sibling->data[j]);
+        }
+        if (!sibling->leaf)
+        {
+            for (int j = 1; j <= sibling->count; ++j)
+                sibling->children[j - 1] = sibling->children[j];
+        }
+        child->count++;
+        sibling->count--;
+    }
+
+    bool removeElement(const TypeKey& key)
+    {
+        TypeNode* p = root;
+        const TypeKey* target = &key;
+        for (;;)
+        {
+            int i = findIndex(p, *target);
+            if (i < p->count && !(*target < p->keys[i]))
+            {
+                if (p->leaf)
+                {
+                    removeFromLeaf(p, i);
+                    return true;
+                }
+                TypeNode* y = p->children[i];
+                TypeNode* z = p->children[i + 1];
+                if (y->count > minKeys)
+                {
+                    TypeNode* q = y;
+                    while (!q->leaf)
+                        q = q->children[q->count];
+                    p->keys[i] = q->keys[q->count - 1];
+                    p->data[i] = q->data[q->count - 1];
+                    target = &p->keys[i];
+                    p = y;
+                }
+                else if (z->count > minKeys)
+                {
+                    TypeNode* q = z;
+                    while (!q->leaf)
+                        q = q->children[0];
+                    p->keys[i] = q->keys[0];
+                    p->data[i] = q->data[0];
+                    target = &p->keys[i];
+                    p = z;
+                }
+                else
+                {
+                    mergeChildren(p, i);
+                    p = y;
+                }
+                continue;
+            }
+            if (p->leaf) return false;
+            if (p->children[i]->count == minKeys)
+            {
+                if (i > 0 && p->children[i - 1]->count > minKeys)
+                    borrowFromPrev(p, i);
+                else if (i < p->count && p->children[i + 1]->count > minKeys)
+                    borrowFromNext(p, i);
+                else if (i < p->count)
+                    mergeChildren(p, i);
+                else
+                {
+                    mergeChildren(p, i - 1);
+                    i--;
+                }
+            }
+            p = p->children[i];
+        }
+    }
+
+    void clearElement(TypeNode* p)
+    {
+        if (!p) return;
+        if (!p->leaf)
+        {
+            for (int i = 0; i <= p->count; ++i)
+                clearElement(p->children[i]);
+        }
+        destroyNode(p);
+    }
+public:
+    explicit BTree(const TypeAlloc& alloc_ = TypeAlloc()) : alloc(alloc_), root(0), numElements(0) {}
+    ~BTree() { clear(); }
+
+    void insert(const std::pair<TypeKey, TypeData>& value)
+    {
+        if (!root)
+            root = createNode(true);
+        if (root->count == maxKeys)
+        {
+            TypeNode* p = createNode(false);
+            p->children[0] = root;
+            root = p;
+            splitChild(root, 0);
+        }
+        insertNonFull(root, value.first, value.second);
+    }
+
+    void erase(const TypeKey& key)
+    {
+        if (!root) return;
+        if (removeElement(key))
+            numElements--;
+        if (root->count == 0)
+        {
+            TypeNode* p = root;
+            root = root->leaf ? 0 : root->children[0];
+            destroyNode(p);
+        }
+    }
+
+    TypeData find(const TypeKey& key)
+    {
+        TypeNode* p = root;
+        while (p)
+        {
+            int i = findIndex(p, key);
+            if (i < p->count && !(key < p->keys[i]))
+                return p->data[i];
+            if (p->leaf) break;
+            p = p->children[i];
+        }
+        return TypeData();
+    }
+
+    size_t size() const
+    {
+        return numElements;
+    }
+
+    void clear()
+    {
+        bool bulk = allocatorRelease<TypeNodeAlloc>::exclusive(alloc);
+        if (!bulk || !std::is_trivially_destructible<TypeNode>::value)
+            clearElement(root);
+        if (bulk)
+            allocatorRelease<TypeNodeAlloc>::release(alloc);
+        root = 0;
+        numElements = 0;
+    }
+};
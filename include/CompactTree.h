@@ -0,0 +1,764 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "KeyCompare.h"
+#include "TreapPriority.h"
+
+template <typename TypeNode>
+class CompactArena
+{
+    static const uint32_t pageShift = 12;
+    static const uint32_t pageSize = 1u << pageShift;
+
+    std::vector<std::vector<TypeNode>> pages;
+    uint32_t used;
+    uint32_t freeList;
+public:
+    CompactArena() : used(0), freeList(0) {}
+
+    TypeNode& operator[](uint32_t i)
+    {
+        --i;
+        return pages[i >> pageShift][i & (pageSize - 1)];
+    }
+
+    const TypeNode& operator[](uint32_t i) const
+    {
+        --i;
+        return pages[i >> pageShift][i & (pageSize - 1)];
+    }
+
+    template <typename TypeK, typename... Args>
+    uint32_t allocate(TypeK&& key, Args&&... data)
+    {
+        if (freeList)
+        {
+            uint32_t i = freeList;
+            TypeNode& p = (*this)[i];
+            freeList = p.left;
+            p = TypeNode(std::forward<TypeK>(key), std::forward<Args>(data)...);
+            return i;
+        }
+        if (used == TypeNode::maxIndex)
+            throw std::length_error("compact tree is full");
+        if ((used & (pageSize - 1)) == 0)
+        {
+            pages.emplace_back();
+            pages.back().reserve(pageSize);
+        }
+        pages.back().emplace_back(std::forward<TypeK>(key), std::forward<Args>(data)...);
+        return ++used;
+    }
+
+    void release(uint32_t i)
+    {
+        TypeNode& p = (*this)[i];
+        p.key = decltype(p.key)();
+        p.data = decltype(p.data)();
+        p.left = freeList;
+        freeList = i;
+    }
+
+    void clear()
+    {
+        pages.clear();
+        used = 0;
+        freeList = 0;
+    }
+};
+
+template <typename TypeKey, typename TypeData>
+struct compactNodeAVL
+{
+    static const uint32_t indexMask = 0x3fffffffu;
+    static const uint32_t maxIndex = indexMask;
+
+    TypeKey key;
+    TypeData data;
+
+    uint32_t left;
+    uint32_t rightBalance;
+
+    template <typename TypeK, typename... Args>
+    compactNodeAVL(TypeK&& k, Args&&... d) : key(std::forward<TypeK>(k)), data(std::forward<Args>(d)...), left(0), rightBalance(1u << 30) {}
+
+    uint32_t right() const
+    {
+        return rightBalance & indexMask;
+    }
+
+    void setRight(uint32_t i)
+    {
+        rightBalance = (rightBalance & ~indexMask) | i;
+    }
+
+    int balance() const
+    {
+        return static_cast<int>(rightBalance >> 30) - 1;
+    }
+
+    void setBalance(int b)
+    {
+        rightBalance = (rightBalance & indexMask) | static_cast<uint32_t>(b + 1) << 30;
+    }
+};
+
+template <typename TypeKey, typename TypeData>
+struct compactNode
+{
+    static const uint32_t maxIndex = 0xffffffffu;
+
+    TypeKey key;
+    TypeData data;
+
+    uint32_t left;
+    uint32_t right;
+
+    template <typename TypeK, typename... Args>
+    compactNode(TypeK&& k, Args&&... d) : key(std::forward<TypeK>(k)), data(std::forward<Args>(d)...), left(0), right(0) {}
+};
+
+template <typename TypeKey, typename TypeData>
+struct compactNodeTreap
+{
+    static const uint32_t maxIndex = 0xffffffffu;
+
+    TypeKey key;
+    TypeData data;
+
+    uint32_t left;
+    uint32_t right;
+    uint32_t priority;
+
+    template <typename TypeK, typename... Args>
+    compactNodeTreap(TypeK&& k, Args&&... d) : key(std::forward<TypeK>(k)), data(std::forward<Args>(d)...), left(0), right(0), priority(0) {}
+};
+
+template <typename TypeKey, typename TypeData, typename TypeCompare = keyCompare>
+class CompactAVLTree
+{
+    typedef compactNodeAVL<TypeKey, TypeData> TypeNode;
+
+    CompactArena<TypeNode> nodes;
+    uint32_t root;
+    size_t numnode;
+    TypeCompare compare;
+
+    uint32_t fixLeftHeavy(uint32_t t, bool& shorter)
+    {
+        TypeNode& p = nodes[t];
+        uint32_t l = p.left;
+        TypeNode& q = nodes[l];
+        if (q.balance() <= 0)
+        {
+            p.left = q.right();
+            q.setRight(t);
+            shorter = q.balance() != 0;
+            p.setBalance(shorter ? 0 : -1);
+            q.setBalance(shorter ? 0 : 1);
+            return l;
+        }
+        uint32_t g = q.right();
+        TypeNode& r = nodes[g];
+        q.setRight(r.left);
+        p.left = r.right();
+        r.left = l;
+        r.setRight(t);
+        p.setBalance(r.balance() == -1 ? 1 : 0);
+        q.setBalance(r.balance() == 1 ? -1 : 0);
+        r.setBalance(0);
+        shorter = true;
+        return g;
+    }
+
+    uint32_t fixRightHeavy(uint32_t t, bool& shorter)
+    {
+        TypeNode& p = nodes[t];
+        uint32_t l = p.right();
+        TypeNode& q = nodes[l];
+        if (q.balance() >= 0)
+        {
+            p.setRight(q.left);
+            q.left = t;
+            shorter = q.balance() != 0;
+            p.setBalance(shorter ? 0 : 1);
+            q.setBalance(shorter ? 0 : -1);
+            return l;
+        }
+        uint32_t g = q.left;
+        TypeNode& r = nodes[g];
+        q.left = r.right();
+        p.setRight(r.left);
+        r.left = t;
+        r.setRight(l);
+        p.setBalance(r.balance() == 1 ? -1 : 0);
+        q.setBalance(r.balance() == -1 ? 1 : 0);
+        r.setBalance(0);
+        shorter = true;
+        return g;
+    }
+
+    uint32_t growLeft(uint32_t t, bool& grew)
+    {
+        TypeNode& p = nodes[t];
+        int b = p.balance() - 1;
+        if (b > -2)
+        {
+            p.setBalance(b);
+            grew = b != 0;
+            return t;
+        }
+        t = fixLeftHeavy(t, grew);
+        grew = false;
+        return t;
+    }
+
+    uint32_t growRight(uint32_t t, bool& grew)
+    {
+        TypeNode& p = nodes[t];
+        int b = p.balance() + 1;
+        if (b < 2)
+        {
+            p.setBalance(b);
+            grew = b != 0;
+            return t;
+        }
+        t = fixRightHeavy(t, grew);
+        grew = false;
+        return t;
+    }
+
+    uint32_t shrinkLeft(uint32_t t, bool& shorter)
+    {
+        TypeNode& p = nodes[t];
+        int b = p.balance() + 1;
+        if (b < 2)
+        {
+            p.setBalance(b);
+            shorter = b == 0;
+            return t;
+        }
+        return fixRightHeavy(t, shorter);
+    }
+
+    uint32_t shrinkRight(uint32_t t, bool& shorter)
+    {
+        TypeNode& p = nodes[t];
+        int b = p.balance() - 1;
+        if (b > -2)
+        {
+            p.setBalance(b);
+            shorter = b == 0;
+            return t;
+        }
+        return fixLeftHeavy(t, shorter);
+    }
+
+    template <typename TypeK, typename... Args>
+    uint32_t insertElement(uint32_t t, bool& grew, bool& inserted, TypeK&& k, Args&&... d)
+    {
+        if (!t)
+        {
+            grew = inserted = true;
+            return nodes.allocate(std::forward<TypeK>(k), std::forward<Args>(d)...);
+        }
+        TypeNode& p = nodes[t];
+        int c = compare(k, p.key);
+        if (c < 0)
+        {
+            p.left = insertElement(p.left, grew, inserted, std::forward<TypeK>(k), std::forward<Args>(d)...);
+            return grew ? growLeft(t, grew) : t;
+        }
+        if (c > 0)
+        {
+            p.setRight(insertElement(p.right(), grew, inserted, std::forward<TypeK>(k), std::forward<Args>(d)...));
+            return grew ? growRight(t, grew) : t;
+        }
+        grew = false;
+        return t;
+    }
+
+    uint32_t removeMin(uint32_t t, uint32_t& m, bool& shorter)
+    {
+        TypeNode& p = nodes[t];
+        if (!p.left)
+        {
+            m = t;
+            shorter = true;
+            return p.right();
+        }
+        p.left = removeMin(p.left, m, shorter);
+        return shorter ? shrinkLeft(t, shorter) : t;
+    }
+
+    template <typename TypeLookup>
+    uint32_t removeElement(uint32_t t, const TypeLookup& key, bool& shorter)
+    {
+        if (!t)
+        {
+            shorter = false;
+            return 0;
+        }
+        TypeNode& p = nodes[t];
+        int c = compare(key, p.key);
+        if (c < 0)
+        {
+            p.left = removeElement(p.left, key, shorter);
+            return shorter ? shrinkLeft(t, shorter) : t;
+        }
+        if (c > 0)
+        {
+            p.setRight(removeElement(p.right(), key, shorter));
+            return shorter ? shrinkRight(t, shorter) : t;
+        }
+        numnode--;
+        if (!p.left || !p.right())
+        {
+            uint32_t child = p.left ? p.left : p.right();
+            nodes.release(t);
+            shorter = true;
+            return child;
+        }
+        uint32_t m;
+        p.setRight(removeMin(p.right(), m, shorter));
+        TypeNode& q = nodes[m];
+        q.left = p.left;
+        q.setRight(p.right());
+        q.setBalance(p.balance());
+        nodes.release(t);
+        return shorter ? shrinkRight(m, shorter) : m;
+    }
+public:
+    explicit CompactAVLTree(const TypeCompare& compare_ = TypeCompare()) : root(0), numnode(0), compare(compare_) {}
+
+    CompactAVLTree(const CompactAVLTree&) = delete;
+    CompactAVLTree& operator=(const CompactAVLTree&) = delete;
+
+    void insert(const std::pair<TypeKey, TypeData>& value)
+    {
+        try_emplace(value.first, value.second);
+    }
+
+    template <typename TypeK, typename... Args>
+    bool try_emplace(TypeK&& key, Args&&... data)
+    {
+        bool grew = false;
+        bool inserted = false;
+        root = insertElement(root, grew, inserted, std::forward<TypeK>(key), std::forward<Args>(data)...);
+        numnode += inserted;
+        return inserted;
+    }
+
+    template <typename TypeLookup>
+    void erase(const TypeLookup& key)
+    {
+        bool shorter = false;
+        root = removeElement(root, key, shorter);
+    }
+
+    template <typename TypeLookup>
+    const TypeData* lookup(const TypeLookup& key) const
+    {
+        uint32_t t = root;
+        while (t)
+        {
+            const TypeNode& p = nodes[t];
+            int c = compare(key, p.key);
+            if (c == 0) return &p.data;
+            t = c < 0 ? p.left : p.right();
+        }
+        return 0;
+    }
+
+    template <typename TypeLookup>
+    TypeData find(const TypeLookup& key) const
+    {
+        const TypeData* data = lookup(key);
+        return data ? *data : TypeData();
+    }
+
+    template <typename TypeLookup>
+    bool contains(const TypeLookup& key) const
+    {
+        return lookup(key) != 0;
+    }
+
+    template <typename Func>
+    void for_each(Func func) const
+    {
+        std::vector<uint32_t> stack;
+        uint32_t t = root;
+        while (t || !stack.empty())
+        {
+            while (t)
+            {
+                stack.push_back(t);
+                t = nodes[t].left;
+            }
+            const TypeNode& p = nodes[stack.back()];
+            stack.pop_back();
+            func(p.key, p.data);
+            t = p.right();
+        }
+    }
+
+    size_t size() const
+    {
+        return numnode;
+    }
+
+    void clear()
+    {
+        nodes.clear();
+        root = 0;
+        numnode = 0;
+    }
+};
+
+template <typename TypeKey, typename TypeData, typename TypeCompare = keyCompare>
+class CompactSplayTree
+{
+    typedef compactNode<TypeKey, TypeData> TypeNode;
+
+    CompactArena<TypeNode> nodes;
+    uint32_t root;
+    size_t numnode;
+    TypeCompare compare;
+
+    template <typename TypeLookup>
+    int splay(const TypeLookup& key)
+    {
+        if (!root) return -1;
+        uint32_t leftTree = 0;
+        uint32_t rightTree = 0;
+        uint32_t* leftHook = &leftTree;
+        uint32_t* rightHook = &rightTree;
+        uint32_t t = root;
+        int c;
+        while (true)
+        {
+            TypeNode* p = &nodes[t];
+            c = compare(key, p->key);
+            if (c < 0)
+            {
+                if (!p->left) break;
+                if (compare(key, nodes[p->left].key) < 0)
+                {
+                    uint32_t l = p->left;
+                    TypeNode& q = nodes[l];
+                    p->left = q.right;
+                    q.right = t;
+                    t = l;
+                    p = &q;
+                    if (!p->left) break;
+                }
+                *rightHook = t;
+                rightHook = &p->left;
+                t = p->left;
+            }
+            else if (c > 0)
+            {
+                if (!p->right) break;
+                if (compare(key, nodes[p->right].key) > 0)
+                {
+                    uint32_t r = p->right;
+                    TypeNode& q = nodes[r];
+                    p->right = q.left;
+                    q.left = t;
+                    t = r;
+                    p = &q;
+                    if (!p->right) break;
+                }
+                *leftHook = t;
+                leftHook = &p->right;
+                t = p->right;
+            }
+            else
+                break;
+        }
+        TypeNode& p = nodes[t];
+        *leftHook = p.left;
+        *rightHook = p.right;
+        p.left = leftTree;
+        p.right = rightTree;
+        root = t;
+        return c;
+    }
+public:
+    explicit CompactSplayTree(const TypeCompare& compare_ = TypeCompare()) : root(0), numnode(0), compare(compare_) {}
+
+    CompactSplayTree(const CompactSplayTree&) = delete;
+    CompactSplayTree& operator=(const CompactSplayTree&) = delete;
+
+    void insert(const std::pair<TypeKey, TypeData>& value)
+    {
+        try_emplace(value.first, value.second);
+    }
+
+    template <typename TypeK, typename... Args>
+    bool try_emplace(TypeK&& key, Args&&... data)
+    {
+        int c = splay(key);
+        if (root && c == 0) return false;
+        uint32_t t = nodes.allocate(std::forward<TypeK>(key), std::forward<Args>(data)...);
+        if (root)
+        {
+            TypeNode& p = nodes[t];
+            TypeNode& q = nodes[root];
+            if (c < 0)
+            {
+                p.left = q.left;
+                p.right = root;
+                q.left = 0;
+            }
+            else
+            {
+                p.right = q.right;
+                p.left = root;
+                q.right = 0;
+            }
+        }
+        root = t;
+        numnode++;
+        return true;
+    }
+
+    template <typename TypeLookup>
+    void erase(const TypeLookup& key)
+    {
+        if (splay(key) != 0 || !root) return;
+        uint32_t t = root;
+        TypeNode& p = nodes[t];
+        if (!p.left)
+            root = p.right;
+        else
+        {
+            uint32_t right = p.right;
+            root = p.left;
+            splay(key);
+            nodes[root].right = right;
+        }
+        nodes.release(t);
+        numnode--;
+    }
+
+    template <typename TypeLookup>
+    TypeData find(const TypeLookup& key)
+    {
+        if (splay(key) != 0 || !root) return TypeData();
+        return nodes[root].data;
+    }
+
+    template <typename TypeLookup>
+    bool contains(const TypeLookup& key)
+    {
+        return root && splay(key) == 0;
+    }
+
+    template <typename Func>
+    void for_each(Func func) const
+    {
+        std::vector<uint32_t> stack;
+        uint32_t t = root;
+        while (t || !stack.empty())
+        {
+            while (t)
+            {
+                stack.push_back(t);
+                t = nodes[t].left;
+            }
+            const TypeNode& p = nodes[stack.back()];
+            stack.pop_back();
+            func(p.key, p.data);
+            t = p.right;
+        }
+    }
+
+    size_t size() const
+    {
+        return numnode;
+    }
+
+    void clear()
+    {
+        nodes.clear();
+        root = 0;
+        numnode = 0;
+    }
+};
+
+template <typename TypeKey, typename TypeData, typename TypeCompare = keyCompare>
+class CompactTreapTree
+{
+    typedef compactNodeTreap<TypeKey, TypeData> TypeNode;
+
+    CompactArena<TypeNode> nodes;
+    uint32_t root;
+    size_t numnode;
+    TypeCompare compare;
+    hashPriority generator;
+
+    uint32_t priority(const TypeKey& key)
+    {
+        return generator.template next<uint32_t>(key);
+    }
+
+    template <typename TypeLookup>
+    void split(uint32_t t, const TypeLookup& key, uint32_t* left, uint32_t* right)
+    {
+        while (t)
+        {
+            TypeNode& p = nodes[t];
+            if (compare(p.key, key) < 0)
+            {
+                *left = t;
+                left = &p.right;
+                t = p.right;
+            }
+            else
+            {
+                *right = t;
+                right = &p.left;
+                t = p.left;
+            }
+        }
+        *left = 0;
+        *right = 0;
+    }
+
+    uint32_t merge(uint32_t left, uint32_t right)
+    {
+        uint32_t result = 0;
+        uint32_t* link = &result;
+        while (left && right)
+        {
+            TypeNode& p = nodes[left];
+            TypeNode& q = nodes[right];
+            if (p.priority < q.priority)
+            {
+                *link = left;
+                link = &p.right;
+                left = p.right;
+            }
+            else
+            {
+                *link = right;
+                link = &q.left;
+                right = q.left;
+            }
+        }
+        *link = left ? left : right;
+        return result;
+    }
+public:
+    explicit CompactTreapTree(const TypeCompare& compare_ = TypeCompare(), const hashPriority& generator_ = hashPriority()) :
+        root(0), numnode(0), compare(compare_), generator(generator_) {}
+
+    CompactTreapTree(const CompactTreapTree&) = delete;
+    CompactTreapTree& operator=(const CompactTreapTree&) = delete;
+
+    void insert(const std::pair<TypeKey, TypeData>& value)
+    {
+        try_emplace(value.first, value.second);
+    }
+
+    template <typename TypeK, typename... Args>
+    bool try_emplace(TypeK&& key, Args&&... data)
+    {
+        // Priorities are a hash of the key, so an existing equal key carries
+        // the same weight and always lies above the point where this stops.
+        uint32_t weight = priority(key);
+        uint32_t* link = &root;
+        while (*link)
+        {
+            TypeNode& q = nodes[*link];
+            if (weight < q.priority) break;
+            int c = compare(key, q.key);
+            if (c == 0) return false;
+            link = c < 0 ? &q.left : &q.right;
+        }
+        uint32_t t = nodes.allocate(std::forward<TypeK>(key), std::forward<Args>(data)...);
+        TypeNode& p = nodes[t];
+        p.priority = weight;
+        split(*link, p.key, &p.left, &p.right);
+        *link = t;
+        numnode++;
+        return true;
+    }
+
+    template <typename TypeLookup>
+    void erase(const TypeLookup& key)
+    {
+        uint32_t* link = &root;
+        int c;
+        while (*link && (c = compare(key, nodes[*link].key)) != 0)
+            link = c < 0 ? &nodes[*link].left : &nodes[*link].right;
+        if (!*link) return;
+        uint32_t t = *link;
+        TypeNode& p = nodes[t];
+        *link = merge(p.left, p.right);
+        nodes.release(t);
+        numnode--;
+    }
+
+    template <typename TypeLookup>
+    const TypeData* lookup(const TypeLookup& key) const
+    {
+        uint32_t t = root;
+        while (t)
+        {
+            const TypeNode& p = nodes[t];
+            int c = compare(key, p.key);
+            if (c == 0) return &p.data;
+            t = c < 0 ? p.left : p.right;
+        }
+        return 0;
+    }
+
+    template <typename TypeLookup>
+    TypeData find(const TypeLookup& key) const
+    {
+        const TypeData* data = lookup(key);
+        return data ? *data : TypeData();
+    }
+
+    template <typename TypeLookup>
+    bool contains(const TypeLookup& key) const
+    {
+        return lookup(key) != 0;
+    }
+
+    template <typename Func>
+    void for_each(Func func) const
+    {
+        std::vector<uint32_t> stack;
+        uint32_t t = root;
+        while (t || !stack.empty())
+        {
+            while (t)
+            {
+                stack.push_back(t);
+                t = nodes[t].left;
+            }
+            const TypeNode& p = nodes[stack.back()];
+            stack.pop_back();
+            func(p.key, p.data);
+            t = p.right;
+        }
+    }
+
+    size_t size() const
+    {
+        return numnode;
+    }
+
+    void clear()
+    {
+        nodes.clear();
+        root = 0;
+        numnode = 0;
+    }
+};
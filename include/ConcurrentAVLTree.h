@@ -0,0 +1,310 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "EpochDomain.h"
+
+template <typename TypeKey, typename TypeData>
+struct nodeConcurrentAVL
+{
+	TypeKey key;
+	TypeData data;
+
+	int height;
+	unsigned long long version;
+
+	nodeConcurrentAVL<TypeKey, TypeData>* left;
+	nodeConcurrentAVL<TypeKey, TypeData>* right;
+
+	nodeConcurrentAVL(const TypeKey &k, const TypeData &d, unsigned long long v) : key(k), data(d), height(1), version(v), left(0), right(0) {}
+};
+
+template <typename TypeKey, typename TypeData, typename TypeAlloc = std::allocator<std::pair<const TypeKey, TypeData>>>
+class ConcurrentAVLTree
+{
+	typedef nodeConcurrentAVL<TypeKey, TypeData> TypeNode;
+	typedef typename std::allocator_traits<TypeAlloc>::template rebind_alloc<TypeNode> TypeNodeAlloc;
+	typedef std::allocator_traits<TypeNodeAlloc> TypeNodeTraits;
+
+	TypeNodeAlloc alloc;
+	std::atomic<TypeNode*> root;
+	std::atomic<size_t> numnodeAVL;
+	std::mutex writer;
+	mutable EpochDomain domain;
+	unsigned long long version;
+	std::vector<TypeNode*> fresh;
+	std::vector<TypeNode*> pending;
+	std::vector<TypeNode*> retired;
+	bool inserted;
+
+	static const size_t reclaimThreshold = 4096;
+
+	TypeNode* createNode(const TypeKey &k, const TypeData &d)
+	{
+		fresh.reserve(fresh.size() + 1);
+		TypeNode* p = TypeNodeTraits::allocate(alloc, 1);
+		try
+		{
+			TypeNodeTraits::construct(alloc, p, k, d, version);
+		}
+		catch (...)
+		{
+			TypeNodeTraits::deallocate(alloc, p, 1);
+			throw;
+		}
+		fresh.push_back(p);
+		return p;
+	}
+
+	void destroyNode(TypeNode* p)
+	{
+		TypeNodeTraits::destroy(alloc, p);
+		TypeNodeTraits::deallocate(alloc, p, 1);
+	}
+
+	void retire(TypeNode* p)
+	{
+		pending.push_back(p);
+	}
+
+	TypeNode* own(TypeNode* p)
+	{
+		if (p->version == version) return p;
+		TypeNode* q = createNode(p->key, p->data);
+		q->height = p->height;
+		q->left = p->left;
+		q->right = p->right;
+		retire(p);
+		return q;
+	}
+
+	int height(TypeNode* p)
+	{
+		return p ? p->height : 0;
+	}
+
+	int balanceFactor(TypeNode* p)
+	{
+		return height(p->right) - height(p->left);
+	}
+
+	void fixHeight(TypeNode* p)
+	{
+		int hl = height(p->left);
+		int hr = height(p->right);
+		p->height = (hl > hr ? hl : hr) + 1;
+	}
+
+	TypeNode* rotateRight(TypeNode* p)
+	{
+		TypeNode* q = own(p->left);
+		p->left = q->right;
+		q->right = p;
+		fixHeight(p);
+		fixHeight(q);
+		return q;
+	}
+
+	TypeNode* rotateLeft(TypeNode* q)
+	{
+		TypeNode* p = own(q->right);
+		q->right = p->left;
+		p->left = q;
+		fixHeight(q);
+		fixHeight(p);
+		return p;
+	}
+
+	TypeNode* balance(TypeNode* p)
+	{
+		fixHeight(p);
+		if (balanceFactor(p) == 2)
+		{
+			if (balanceFactor(p->right) < 0)
+				p->right = rotateRight(own(p->right));
+			return rotateLeft(p);
+		}
+		if (balanceFactor(p) == -2)
+		{
+			if (balanceFactor(p->left) > 0)
+				p->left = rotateLeft(own(p->left));
+			return rotateRight(p);
+		}
+		return p;
+	}
+
+	TypeNode* insertElement(TypeNode* p, const TypeKey &k, const TypeData &d)
+	{
+		if (!p)
+		{
+			inserted = true;
+			return createNode(k, d);
+		}
+		p = own(p);
+		if (k < p->key)
+			p->left = insertElement(p->left, k, d);
+		else if (p->key < k)
+			p->right = insertElement(p->right, k, d);
+		else
+		{
+			p->data = d;
+			return p;
+		}
+		return balance(p);
+	}
+
+	TypeNode* findMin(TypeNode* p)
+	{
+		while (p->left)
+			p = p->left;
+		return p;
+	}
+
+	TypeNode* removeMin(TypeNode* p)
+	{
+		if (!p->left)
+		{
+			retire(p);
+			return p->right;
+		}
+		p = own(p);
+		p->left = removeMin(p->left);
+		return balance(p);
+	}
+
+	TypeNode* removeElement(TypeNode* p, const TypeKey &k)
+	{
+		if (k < p->key)
+		{
+			p = own(p);
+			p->left = removeElement(p->left, k);
+			return balance(p);
+		}
+		if (p->key < k)
+		{
+			p = own(p);
+			p->right = removeElement(p->right, k);
+			return balance(p);
+		}
+		TypeNode* q = p->left;
+		TypeNode* r = p->right;
+		retire(p);
+		if (!r) return q;
+		TypeNode* min = findMin(r);
+		TypeNode* m = createNode(min->key, min->data);
+		m->right = removeMin(r);
+		m->left = q;
+		return balance(m);
+	}
+
+	TypeNode* findElement(TypeNode* p, const TypeKey &k) const
+	{
+		while (p)
+		{
+			if (k < p->key)
+				p = p->left;
+			else if (p->key < k)
+				p = p->right;
+			else
+				return p;
+		}
+		return 0;
+	}
+
+	template <typename Func>
+	void write(Func func)
+	{
+		version++;
+		TypeNode* p;
+		try
+		{
+			p = func(root.load(std::memory_order_relaxed));
+		}
+		catch (...)
+		{
+			for (size_t i = 0; i < fresh.size(); ++i)
+				destroyNode(fresh[i]);
+			fresh.clear();
+			pending.clear();
+			throw;
+		}
+		root.store(p, std::memory_order_release);
+		fresh.clear();
+		retired.insert(retired.end(), pending.begin(), pending.end());
+		pending.clear();
+		if (retired.size() >= reclaimThreshold)
+			reclaim();
+	}
+
+	void reclaim()
+	{
+		domain.synchronize();
+		for (size_t i = 0; i < retired.size(); ++i)
+			destroyNode(retired[i]);
+		retired.clear();
+	}
+
+	void clearElement(TypeNode* p)
+	{
+		std::vector<TypeNode*> stack;
+		if (p) stack.push_back(p);
+		while (!stack.empty())
+		{
+			p = stack.back();
+			stack.pop_back();
+			if (p->left) stack.push_back(p->left);
+			if (p->right) stack.push_back(p->right);
+			destroyNode(p);
+		}
+	}
+public:
+	explicit ConcurrentAVLTree(const TypeAlloc& alloc_ = TypeAlloc()) : alloc(alloc_), root(0), numnodeAVL(0), version(0), inserted(false) {}
+	~ConcurrentAVLTree()
+	{
+		clearElement(root.load());
+		for (size_t i = 0; i < retired.size(); ++i)
+			destroyNode(retired[i]);
+	}
+
+	ConcurrentAVLTree(const ConcurrentAVLTree&) = delete;
+	ConcurrentAVLTree& operator=(const ConcurrentAVLTree&) = delete;
+
+	void insert(const std::pair<TypeKey, TypeData> &value)
+	{
+		std::lock_guard<std::mutex> lock(writer);
+		inserted = false;
+		write([this, &value](TypeNode* p) { return insertElement(p, value.first, value.second); });
+		if (inserted)
+			numnodeAVL++;
+	}
+
+	void erase(const TypeKey &key)
+	{
+		std::lock_guard<std::mutex> lock(writer);
+		if (!findElement(root.load(std::memory_order_relaxed), key)) return;
+		write([this, &key](TypeNode* p) { return removeElement(p, key); });
+		numnodeAVL--;
+	}
+
+	TypeData find(const TypeKey &key) const
+	{
+		epochGuard guard(domain);
+		TypeNode* p = findElement(root.load(std::memory_order_acquire), key);
+		return p ? p->data : TypeData();
+	}
+
+	size_t size() const
+	{
+		return numnodeAVL.load();
+	}
+
+	void clear()
+	{
+		std::lock_guard<std::mutex> lock(writer);
+		TypeNode* p = root.exchange(0);
+		reclaim();
+		clearElement(p);
+		numnodeAVL = 0;
+	}
+};
@@ -0,0 +1,75 @@
+#pragma once
+#include <atomic>
+#include <thread>
+
+class EpochDomain
+{
+    static const int stripes = 64;
+
+    struct counter
+    {
+        std::atomic<long> value;
+        char pad[64 - sizeof(std::atomic<long>)];
+    };
+
+    std::atomic<unsigned long long> epoch;
+    counter active[2][stripes];
+
+    static int threadStripe()
+    {
+        static std::atomic<unsigned> next(0);
+        static thread_local int stripe = static_cast<int>(next.fetch_add(1) % stripes);
+        return stripe;
+    }
+public:
+    EpochDomain() : epoch(0)
+    {
+        for (int i = 0; i < 2; ++i)
+            for (int j = 0; j < stripes; ++j)
+                active[i][j].value.store(0);
+    }
+
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    int enter()
+    {
+        int stripe = threadStripe();
+        for (;;)
+        {
+            unsigned long long e = epoch.load();
+            std::atomic<long>& count = active[e & 1][stripe].value;
+            count.fetch_add(1);
+            if (epoch.load() == e)
+                return static_cast<int>(e & 1) * stripes + stripe;
+            count.fetch_sub(1);
+        }
+    }
+
+    void exit(int token)
+    {
+        active[token / stripes][token % stripes].value.fetch_sub(1, std::memory_order_release);
+    }
+
+    void synchronize()
+    {
+        unsigned long long e = epoch.fetch_add(1);
+        for (int i = 0; i < stripes; ++i)
+        {
+            while (active[e & 1][i].value.load() != 0)
+                std::this_thread::yield();
+        }
+    }
+};
+
+class epochGuard
+{
+    EpochDomain& domain;
+    int token;
+public:
+    explicit epochGuard(EpochDomain& domain_) : domain(domain_), token(domain_.enter()) {}
+    ~epochGuard() { domain.exit(token); }
+
+    epochGuard(const epochGuard&) = delete;
+    epochGuard& operator=(const epochGuard&) = delete;
+};
@@ -0,0 +1,29 @@
+#pragma once
+#include <future>
+#include <thread>
+#include <utility>
+
+const size_t forkCutoff = 1 << 14;
+
+inline int forkDepth()
+{
+    unsigned threads = std::thread::hardware_concurrency();
+    int depth = 0;
+    while ((1u << depth) < threads)
+        depth++;
+    return depth;
+}
+
+template <typename FuncLeft, typename FuncRight>
+void forkJoin(bool parallel, FuncLeft&& left, FuncRight&& right)
+{
+    if (!parallel)
+    {
+        left();
+        right();
+        return;
+    }
+    std::future<void> future = std::async(std::launch::async, std::forward<FuncLeft>(left));
+    right();
+    future.get();
+}
@@ -0,0 +1,151 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+template <typename TypeA, typename TypeB>
+int compareKeys(const TypeA& a, const TypeB& b)
+{
+    if constexpr (std::is_convertible<const TypeA&, std::string_view>::value && std::is_convertible<const TypeB&, std::string_view>::value)
+    {
+        int c = std::string_view(a).compare(std::string_view(b));
+        return (c > 0) - (c < 0);
+    }
+    else if constexpr (std::is_arithmetic<TypeA>::value && std::is_arithmetic<TypeB>::value)
+        return a == b ? 0 : (a < b ? -1 : 1);
+    else
+        return a < b ? -1 : (b < a ? 1 : 0);
+}
+
+inline uint64_t keyPrefix(std::string_view key)
+{
+    unsigned char bytes[8] = {};
+    std::memcpy(bytes, key.data(), std::min<size_t>(key.size(), sizeof(bytes)));
+    uint64_t prefix = 0;
+    for (size_t i = 0; i < sizeof(bytes); ++i)
+        prefix = prefix << 8 | bytes[i];
+    return prefix;
+}
+
+struct noKeyCache
+{
+    template <typename TypeKey>
+    void cacheKey(const TypeKey&) {}
+};
+
+template <typename TypeStored>
+struct keyProbe
+{
+    TypeStored key;
+
+    template <typename TypeLookup>
+    explicit keyProbe(const TypeLookup& key_) : key(key_) {}
+};
+
+struct keyCompare
+{
+    typedef void is_transparent;
+    typedef noKeyCache nodeCache;
+
+    template <typename TypeStored>
+    using probe = keyProbe<TypeStored>;
+
+    template <typename TypeA, typename TypeB>
+    int operator()(const TypeA& a, const TypeB& b) const
+    {
+        return compareKeys(a, b);
+    }
+
+    template <typename TypeStored, typename TypeNode>
+    int operator()(const keyProbe<TypeStored>& q, TypeNode* p) const
+    {
+        return compareKeys(q.key, p->key);
+    }
+};
+
+template <typename TypeLess>
+struct lessCompare : TypeLess
+{
+    typedef noKeyCache nodeCache;
+
+    template <typename TypeStored>
+    using probe = keyProbe<TypeStored>;
+
+    lessCompare(const TypeLess& less = TypeLess()) : TypeLess(less) {}
+
+    template <typename TypeA, typename TypeB>
+    int operator()(const TypeA& a, const TypeB& b) const
+    {
+        const TypeLess& less = *this;
+        return less(a, b) ? -1 : (less(b, a) ? 1 : 0);
+    }
+
+    template <typename TypeStored, typename TypeNode>
+    int operator()(const keyProbe<TypeStored>& q, TypeNode* p) const
+    {
+        return (*this)(q.key, p->key);
+    }
+};
+
+struct prefixCompare
+{
+    typedef void is_transparent;
+
+    struct nodeCache
+    {
+        uint64_t prefix;
+
+        template <typename TypeKey>
+        void cacheKey(const TypeKey& key)
+        {
+            prefix = keyPrefix(key);
+        }
+    };
+
+    template <typename TypeStored>
+    struct probe : keyProbe<TypeStored>
+    {
+        uint64_t prefix;
+
+        template <typename TypeLookup>
+        explicit probe(const TypeLookup& key_) : keyProbe<TypeStored>(key_), prefix(keyPrefix(this->key)) {}
+    };
+
+    template <typename TypeA, typename TypeB>
+    int operator()(const TypeA& a, const TypeB& b) const
+    {
+        return compareKeys(a, b);
+    }
+
+    template <typename TypeStored, typename TypeNode>
+    int operator()(const probe<TypeStored>& q, TypeNode* p) const
+    {
+        if (q.prefix != p->prefix)
+            return q.prefix < p->prefix ? -1 : 1;
+        std::string_view a(q.key);
+        std::string_view b(p->key);
+        if (a.size() >= sizeof(q.prefix) && b.size() >= sizeof(q.prefix))
+        {
+            a.remove_prefix(sizeof(q.prefix));
+            b.remove_prefix(sizeof(q.prefix));
+        }
+        return compareKeys(a, b);
+    }
+};
+
+template <typename TypeCompare, typename = void>
+struct isTransparent : std::false_type {};
+
+template <typename TypeCompare>
+struct isTransparent<TypeCompare, std::void_t<typename TypeCompare::is_transparent>> : std::true_type {};
+
+template <typename TypeCompare, typename TypeKey, typename TypeLookup>
+struct compareProbe
+{
+    typedef typename std::remove_cv<typename std::remove_reference<TypeLookup>::type>::type TypeBare;
+    typedef typename std::conditional<isTransparent<TypeCompare>::value || std::is_same<TypeBare, TypeKey>::value,
+        const TypeBare&, TypeKey>::type TypeStored;
+    typedef typename TypeCompare::template probe<TypeStored> type;
+};
@@ -0,0 +1,176 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+class NodeArena
+{
+    struct freeNode
+    {
+        freeNode* next;
+    };
+
+    size_t sizeNode;
+    size_t alignNode;
+    size_t nodesPerSlab;
+    std::vector<void*> slabs;
+    char* current;
+    char* end;
+    freeNode* freeList;
+
+    static const size_t firstSlab = 64;
+    static const size_t maxSlab = 65536;
+
+    void newSlab()
+    {
+        void* raw = ::operator new(nodesPerSlab * sizeNode + alignNode);
+        slabs.push_back(raw);
+        uintptr_t address = reinterpret_cast<uintptr_t>(raw);
+        address = (address + alignNode - 1) / alignNode * alignNode;
+        current = reinterpret_cast<char*>(address);
+        end = current + nodesPerSlab * sizeNode;
+        if (nodesPerSlab < maxSlab)
+            nodesPerSlab *= 2;
+    }
+
+    static size_t nodeAlign(size_t align)
+    {
+        return align < alignof(freeNode) ? alignof(freeNode) : align;
+    }
+
+    static size_t nodeSize(size_t size, size_t align)
+    {
+        size = size < sizeof(freeNode) ? sizeof(freeNode) : size;
+        return (size + nodeAlign(align) - 1) / nodeAlign(align) * nodeAlign(align);
+    }
+public:
+    NodeArena(size_t size, size_t align) : sizeNode(nodeSize(size, align)), alignNode(nodeAlign(align)),
+        nodesPerSlab(firstSlab), current(0), end(0), freeList(0) {}
+    ~NodeArena() { release(); }
+
+    NodeArena(const NodeArena&) = delete;
+    NodeArena& operator=(const NodeArena&) = delete;
+
+    bool serves(size_t size, size_t align) const
+    {
+        return sizeNode == nodeSize(size, align) && alignNode == nodeAlign(align);
+    }
+
+    void* allocate()
+    {
+        if (freeList)
+        {
+            freeNode* p = freeList;
+            freeList = p->next;
+            return p;
+        }
+        if (current == end)
+            newSlab();
+        void* p = current;
+        current += sizeNode;
+        return p;
+    }
+
+    void deallocate(void* p)
+    {
+        freeNode* q = static_cast<freeNode*>(p);
+        q->next = freeList;
+        freeList = q;
+    }
+
+    void release()
+    {
+        for (size_t i = 0; i < slabs.size(); ++i)
+            ::operator delete(slabs[i]);
+        slabs.clear();
+        current = 0;
+        end = 0;
+        freeList = 0;
+        nodesPerSlab = firstSlab;
+    }
+};
+
+class NodePool
+{
+    std::vector<std::unique_ptr<NodeArena>> arenas;
+public:
+    NodeArena* arena(size_t size, size_t align)
+    {
+        for (size_t i = 0; i < arenas.size(); ++i)
+        {
+            if (arenas[i]->serves(size, align))
+                return arenas[i].get();
+        }
+        arenas.push_back(std::unique_ptr<NodeArena>(new NodeArena(size, align)));
+        return arenas.back().get();
+    }
+};
+
+template <typename T>
+class PoolAllocator
+{
+    template <typename U> friend class PoolAllocator;
+
+    std::shared_ptr<NodePool> pool;
+    NodeArena* arena;
+public:
+    typedef T value_type;
+
+    PoolAllocator() : pool(std::make_shared<NodePool>()), arena(pool->arena(sizeof(T), alignof(T))) {}
+    PoolAllocator(const PoolAllocator& other) : pool(other.pool), arena(other.arena) {}
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>& other) : pool(other.pool), arena(pool->arena(sizeof(T), alignof(T))) {}
+
+    T* allocate(size_t n)
+    {
+        if (n == 1)
+            return static_cast<T*>(arena->allocate());
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+        if (n == 1)
+            arena->deallocate(p);
+        else
+            ::operator delete(p);
+    }
+
+    bool exclusive() const
+    {
+        return pool.use_count() == 1;
+    }
+
+    void release()
+    {
+        arena->release();
+    }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U>& other) const
+    {
+        return pool == other.pool;
+    }
+
+    template <typename U>
+    bool operator!=(const PoolAllocator<U>& other) const
+    {
+        return pool != other.pool;
+    }
+};
+
+template <typename TypeAlloc>
+struct allocatorRelease
+{
+    static bool exclusive(const TypeAlloc&) { return false; }
+    static void release(TypeAlloc&) {}
+};
+
+template <typename T>
+struct allocatorRelease<PoolAllocator<T>>
+{
+    static bool exclusive(const PoolAllocator<T>& alloc) { return alloc.exclusive(); }
+    static void release(PoolAllocator<T>& alloc) { alloc.release(); }
+};
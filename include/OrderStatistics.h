@@ -0,0 +1,452 @@
+#pragma once
+#include <cstddef>
+#include <limits>
+#include <vector>
+#include "TreeIterator.h"
+
+struct noOrderStatistics
+{
+    static const bool enabled = false;
+    static const bool lazy = false;
+
+    struct nodeAugment {};
+
+    template <typename TypeNode, typename TypeKey, typename TypeData, size_t Capacity>
+    using pathCarry = plainCarry<TypeNode, TypeKey, TypeData>;
+
+    template <typename TypeNode>
+    static void update(TypeNode*) {}
+
+    template <typename TypeNode>
+    static void push(TypeNode*) {}
+};
+
+struct orderStatistics
+{
+    static const bool enabled = true;
+    static const bool lazy = false;
+
+    struct nodeAugment
+    {
+        size_t size;
+
+        nodeAugment() : size(1) {}
+    };
+
+    template <typename TypeNode, typename TypeKey, typename TypeData, size_t Capacity>
+    using pathCarry = plainCarry<TypeNode, TypeKey, TypeData>;
+
+    template <typename TypeNode>
+    static size_t size(const TypeNode* p)
+    {
+        return p ? p->size : 0;
+    }
+
+    template <typename TypeNode>
+    static void update(TypeNode* p)
+    {
+        p->size = size(p->left) + size(p->right) + 1;
+    }
+
+    template <typename TypeNode>
+    static void push(TypeNode*) {}
+};
+
+template <typename TypeValue>
+struct sumMonoid
+{
+    typedef TypeValue value_type;
+
+    static TypeValue identity() { return TypeValue(); }
+    static TypeValue combine(const TypeValue& a, const TypeValue& b) { return a + b; }
+    static TypeValue add(const TypeValue& total, const TypeValue& delta, size_t n) { return total + delta * static_cast<TypeValue>(n); }
+
+    template <typename TypeKey, typename TypeData>
+    static TypeValue lift(const TypeKey&, const TypeData& data) { return data; }
+};
+
+template <typename TypeValue>
+struct minMonoid
+{
+    typedef TypeValue value_type;
+
+    static TypeValue identity() { return std::numeric_limits<TypeValue>::max(); }
+    static TypeValue combine(const TypeValue& a, const TypeValue& b) { return b < a ? b : a; }
+    static TypeValue add(const TypeValue& total, const TypeValue& delta, size_t) { return total + delta; }
+
+    template <typename TypeKey, typename TypeData>
+    static TypeValue lift(const TypeKey&, const TypeData& data) { return data; }
+};
+
+template <typename TypeValue>
+struct maxMonoid
+{
+    typedef TypeValue value_type;
+
+    static TypeValue identity() { return std::numeric_limits<TypeValue>::lowest(); }
+    static TypeValue combine(const TypeValue& a, const TypeValue& b) { return a < b ? b : a; }
+    static TypeValue add(const TypeValue& total, const TypeValue& delta, size_t) { return total + delta; }
+
+    template <typename TypeKey, typename TypeData>
+    static TypeValue lift(const TypeKey&, const TypeData& data) { return data; }
+};
+
+template <typename TypeMonoid>
+struct subtreeAggregate
+{
+    typedef TypeMonoid monoid;
+    typedef typename TypeMonoid::value_type value_type;
+
+    static const bool enabled = true;
+    static const bool lazy = false;
+
+    struct nodeAugment
+    {
+        size_t size;
+        value_type total;
+
+        nodeAugment() : size(1), total(TypeMonoid::identity()) {}
+    };
+
+    template <typename TypeNode, typename TypeKey, typename TypeData, size_t Capacity>
+    using pathCarry = plainCarry<TypeNode, TypeKey, TypeData>;
+
+    template <typename TypeNode>
+    static size_t size(const TypeNode* p)
+    {
+        return p ? p->size : 0;
+    }
+
+    template <typename TypeNode>
+    static value_type total(const TypeNode* p)
+    {
+        return p ? p->total : TypeMonoid::identity();
+    }
+
+    template <typename TypeNode>
+    static value_type value(const TypeNode* p)
+    {
+        return TypeMonoid::lift(p->key, p->data);
+    }
+
+    template <typename TypeNode>
+    static value_type descend(const TypeNode*, const value_type& carry)
+    {
+        return carry;
+    }
+
+    template <typename TypeNode>
+    static value_type total(const TypeNode* p, const value_type&)
+    {
+        return total(p);
+    }
+
+    template <typename TypeNode>
+    static value_type value(const TypeNode* p, const value_type&)
+    {
+        return value(p);
+    }
+
+    template <typename TypeNode>
+    static void update(TypeNode* p)
+    {
+        p->size = size(p->left) + size(p->right) + 1;
+        p->total = TypeMonoid::combine(TypeMonoid::combine(total(p->left), value(p)), total(p->right));
+    }
+
+    template <typename TypeNode>
+    static void push(TypeNode*) {}
+};
+
+template <typename TypeOrder, typename TypeNode, typename TypeKey, typename TypeData, size_t Capacity>
+struct lazyCarry : plainCarry<TypeNode, TypeKey, TypeData>
+{
+    lazyCarry() {}
+
+    template <typename TypeOther>
+    lazyCarry(const TypeOther&, size_t) {}
+
+    void push(TypeNode* p)
+    {
+        TypeOrder::push(p);
+    }
+};
+
+template <typename TypeOrder, typename TypeNode, typename TypeKey, typename TypeData, size_t Capacity>
+class lazyCarry<TypeOrder, TypeNode, TypeKey, const TypeData, Capacity>
+{
+    typedef typename TypeOrder::value_type value_type;
+
+    pathStack<value_type, Capacity> carries;
+
+    value_type below() const
+    {
+        return carries.empty() ? value_type() : carries.top();
+    }
+public:
+    typedef std::pair<const TypeKey&, TypeData> reference;
+
+    lazyCarry() {}
+
+    template <typename TypeOther>
+    lazyCarry(const TypeOther&, size_t depth)
+    {
+        for (size_t i = 0; i < depth; ++i)
+            carries.push(value_type());
+    }
+
+    void push(TypeNode* p)
+    {
+        carries.push(TypeOrder::descend(p, below()));
+    }
+
+    void pop()
+    {
+        carries.pop();
+    }
+
+    void truncate(size_t n)
+    {
+        carries.truncate(n);
+    }
+
+    reference view(TypeNode* p) const
+    {
+        TypeData data = p->data;
+        data += below();
+        return reference(p->key, data);
+    }
+};
+
+template <typename TypeMonoid>
+struct lazySubtreeAggregate : subtreeAggregate<TypeMonoid>
+{
+    typedef typename TypeMonoid::value_type value_type;
+
+    static const bool lazy = true;
+
+    using subtreeAggregate<TypeMonoid>::total;
+    using subtreeAggregate<TypeMonoid>::value;
+
+    template <typename TypeNode, typename TypeKey, typename TypeData, size_t Capacity>
+    using pathCarry = lazyCarry<lazySubtreeAggregate, TypeNode, TypeKey, TypeData, Capacity>;
+
+    struct nodeAugment
+    {
+        size_t size;
+        value_type total;
+        value_type pending;
+        bool tagged;
+
+        nodeAugment() : size(1), total(TypeMonoid::identity()), pending(), tagged(false) {}
+    };
+
+    template <typename TypeNode>
+    static void apply(TypeNode* p, const value_type& delta)
+    {
+        if (!p) return;
+        p->data += delta;
+        p->total = TypeMonoid::add(p->total, delta, p->size);
+        p->pending = p->tagged ? p->pending + delta : delta;
+        p->tagged = true;
+    }
+
+    template <typename TypeNode>
+    static value_type descend(const TypeNode* p, const value_type& carry)
+    {
+        return p->tagged ? carry + p->pending : carry;
+    }
+
+    template <typename TypeNode>
+    static value_type total(const TypeNode* p, const value_type& carry)
+    {
+        return p ? TypeMonoid::add(p->total, carry, p->size) : TypeMonoid::identity();
+    }
+
+    template <typename TypeNode>
+    static value_type value(const TypeNode* p, const value_type& carry)
+    {
+        return TypeMonoid::lift(p->key, p->data + carry);
+    }
+
+    template <typename TypeNode>
+    static void push(TypeNode* p)
+    {
+        if (!p->tagged) return;
+        apply(p->left, p->pending);
+        apply(p->right, p->pending);
+        p->tagged = false;
+    }
+};
+
+template <bool Enabled, typename TypeOrder, typename TypeNode, size_t Capacity>
+class updatePath
+{
+    nodePath<TypeNode, Capacity> nodes;
+public:
+    void push(TypeNode* p)
+    {
+        nodes.push(p);
+    }
+
+    void refresh()
+    {
+        while (!nodes.empty())
+            TypeOrder::update(nodes.pop());
+    }
+};
+
+template <typename TypeOrder, typename TypeNode, size_t Capacity>
+class updatePath<false, TypeOrder, TypeNode, Capacity>
+{
+public:
+    void push(TypeNode*) {}
+    void refresh() {}
+};
+
+template <typename TypeOrder, typename TypeNode>
+void refreshSubtree(TypeNode* root)
+{
+    if (!TypeOrder::enabled || !root) return;
+    std::vector<TypeNode*> order(1, root);
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        if (order[i]->left) order.push_back(order[i]->left);
+        if (order[i]->right) order.push_back(order[i]->right);
+    }
+    for (size_t i = order.size(); i-- > 0; )
+        TypeOrder::update(order[i]);
+}
+
+template <typename TypeOrder, typename TypeNode, typename TypeCompare, typename TypeProbe>
+size_t rankElement(const TypeNode* p, const TypeCompare& compare, const TypeProbe& q)
+{
+    size_t rank = 0;
+    while (p)
+    {
+        if (compare(q, p) > 0)
+        {
+            rank += TypeOrder::size(p->left) + 1;
+            p = p->right;
+        }
+        else
+            p = p->left;
+    }
+    return rank;
+}
+
+template <typename TypeOrder, typename TypeIterator, typename TypeNode>
+TypeIterator selectElement(TypeNode* const* root, size_t k)
+{
+    return TypeIterator::bound(root, [&k](const TypeNode* p)
+    {
+        size_t left = TypeOrder::size(p->left);
+        if (left >= k) return false;
+        k -= left + 1;
+        return true;
+    });
+}
+
+template <typename TypeOrder, typename TypeNode, typename TypeCompare, typename TypeProbe>
+typename TypeOrder::value_type aggregateElement(const TypeNode* p, const TypeCompare& compare, const TypeProbe& lo, const TypeProbe& hi)
+{
+    typedef typename TypeOrder::monoid TypeMonoid;
+    typedef typename TypeOrder::value_type TypeValue;
+    TypeValue carry = TypeValue();
+    while (p)
+    {
+        TypeValue below = TypeOrder::descend(p, carry);
+        if (compare(lo, p) > 0)
+            p = p->right;
+        else if (compare(hi, p) <= 0)
+            p = p->left;
+        else
+            break;
+        carry = below;
+    }
+    if (!p) return TypeMonoid::identity();
+    TypeValue left = TypeMonoid::identity();
+    TypeValue inner = TypeOrder::descend(p, carry);
+    for (const TypeNode* q = p->left; q; )
+    {
+        TypeValue below = TypeOrder::descend(q, inner);
+        if (compare(lo, q) <= 0)
+        {
+            left = TypeMonoid::combine(TypeMonoid::combine(TypeOrder::value(q, inner), TypeOrder::total(q->right, below)), left);
+            q = q->left;
+        }
+        else
+            q = q->right;
+        inner = below;
+    }
+    TypeValue right = TypeMonoid::identity();
+    inner = TypeOrder::descend(p, carry);
+    for (const TypeNode* q = p->right; q; )
+    {
+        TypeValue below = TypeOrder::descend(q, inner);
+        if (compare(hi, q) > 0)
+        {
+            right = TypeMonoid::combine(right, TypeMonoid::combine(TypeOrder::total(q->left, below), TypeOrder::value(q, inner)));
+            q = q->right;
+        }
+        else
+            q = q->left;
+        inner = below;
+    }
+    return TypeMonoid::combine(TypeMonoid::combine(left, TypeOrder::value(p, carry)), right);
+}
+
+template <typename TypeOrder, typename TypeNode, typename TypeCompare, typename TypeProbe>
+void updateRangeElement(TypeNode* p, const TypeCompare& compare, const TypeProbe& lo, const TypeProbe& hi, const typename TypeOrder::value_type& delta)
+{
+    nodePath<TypeNode, 128> touched;
+    while (p)
+    {
+        TypeOrder::push(p);
+        if (compare(lo, p) > 0)
+        {
+            touched.push(p);
+            p = p->right;
+        }
+        else if (compare(hi, p) <= 0)
+        {
+            touched.push(p);
+            p = p->left;
+        }
+        else
+            break;
+    }
+    if (p)
+    {
+        touched.push(p);
+        p->data += delta;
+        for (TypeNode* q = p->left; q; )
+        {
+            TypeOrder::push(q);
+            touched.push(q);
+            if (compare(lo, q) > 0)
+                q = q->right;
+            else
+            {
+                q->data += delta;
+                TypeOrder::apply(q->right, delta);
+                q = q->left;
+            }
+        }
+        for (TypeNode* q = p->right; q; )
+        {
+            TypeOrder::push(q);
+            touched.push(q);
+            if (compare(hi, q) <= 0)
+                q = q->left;
+            else
+            {
+                q->data += delta;
+                TypeOrder::apply(q->left, delta);
+                q = q->right;
+            }
+        }
+    }
+    while (!touched.empty())
+        TypeOrder::update(touched.pop());
+}
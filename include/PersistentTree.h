@@ -0,0 +1,583 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "KeyCompare.h"
+#include "TreapPriority.h"
+
+// Nodes are shared between versions and counted by the number of parents and
+// roots pointing at them. A node reached through uniquely owned ancestors with
+// a count of one belongs to this version alone and is updated in place; any
+// other node on a mutated path is copied first. Versions can be read and
+// released on any thread, but each version must be mutated by one thread.
+template <typename TypeNode, typename TypeAlloc>
+class persistentNodes
+{
+    typedef typename std::allocator_traits<TypeAlloc>::template rebind_alloc<TypeNode> TypeNodeAlloc;
+    typedef std::allocator_traits<TypeNodeAlloc> TypeNodeTraits;
+
+    TypeNodeAlloc alloc;
+public:
+    explicit persistentNodes(const TypeAlloc& alloc_) : alloc(alloc_) {}
+
+    template <typename... Args>
+    TypeNode* create(Args&&... args)
+    {
+        TypeNode* p = TypeNodeTraits::allocate(alloc, 1);
+        try
+        {
+            TypeNodeTraits::construct(alloc, p, std::forward<Args>(args)...);
+        }
+        catch (...)
+        {
+            TypeNodeTraits::deallocate(alloc, p, 1);
+            throw;
+        }
+        return p;
+    }
+
+    static TypeNode* acquire(TypeNode* p)
+    {
+        if (p)
+            p->refs.fetch_add(1, std::memory_order_relaxed);
+        return p;
+    }
+
+    void release(TypeNode* p)
+    {
+        std::vector<TypeNode*> stack;
+        for (;;)
+        {
+            while (p && (p->refs.load(std::memory_order_acquire) == 1 || p->refs.fetch_sub(1, std::memory_order_acq_rel) == 1))
+            {
+                if (p->left) stack.push_back(p->left);
+                TypeNode* r = p->right;
+                TypeNodeTraits::destroy(alloc, p);
+                TypeNodeTraits::deallocate(alloc, p, 1);
+                p = r;
+            }
+            if (stack.empty()) return;
+            p = stack.back();
+            stack.pop_back();
+        }
+    }
+
+    TypeNode* unique(TypeNode* p)
+    {
+        if (p->refs.load(std::memory_order_acquire) == 1)
+            return p;
+        TypeNode* q = create(static_cast<const TypeNode&>(*p));
+        acquire(q->left);
+        acquire(q->right);
+        release(p);
+        return q;
+    }
+};
+
+template <typename TypeKey, typename TypeData, typename TypeCompare = keyCompare>
+struct persistentNodeAVL : TypeCompare::nodeCache
+{
+    TypeKey key;
+    TypeData data;
+
+    int height;
+    std::atomic<uint32_t> refs;
+
+    persistentNodeAVL<TypeKey, TypeData, TypeCompare>* left;
+    persistentNodeAVL<TypeKey, TypeData, TypeCompare>* right;
+
+    template <typename TypeK, typename... Args>
+    persistentNodeAVL(TypeK&& k, Args&&... d) : key(std::forward<TypeK>(k)), data(std::forward<Args>(d)...), height(1), refs(1), left(0), right(0)
+    {
+        this->cacheKey(key);
+    }
+
+    persistentNodeAVL(const persistentNodeAVL& p) :
+        TypeCompare::nodeCache(p), key(p.key), data(p.data), height(p.height), refs(1), left(p.left), right(p.right) {}
+};
+
+template <typename TypeKey, typename TypePriority, typename TypeData, typename TypeCompare = keyCompare>
+struct persistentNodeTreap : TypeCompare::nodeCache
+{
+    TypeKey key;
+    TypePriority priority;
+    TypeData data;
+
+    std::atomic<uint32_t> refs;
+
+    persistentNodeTreap<TypeKey, TypePriority, TypeData, TypeCompare>* left;
+    persistentNodeTreap<TypeKey, TypePriority, TypeData, TypeCompare>* right;
+
+    template <typename TypeK, typename... Args>
+    persistentNodeTreap(TypeK&& k, const TypePriority& priority_, Args&&... d) :
+        key(std::forward<TypeK>(k)), priority(priority_), data(std::forward<Args>(d)...), refs(1), left(0), right(0)
+    {
+        this->cacheKey(key);
+    }
+
+    persistentNodeTreap(const persistentNodeTreap& p) :
+        TypeCompare::nodeCache(p), key(p.key), priority(p.priority), data(p.data), refs(1), left(p.left), right(p.right) {}
+};
+
+template <typename TypeNode, typename TypeLookup, typename TypeCompare>
+const TypeNode* persistentLookup(const TypeNode* p, const TypeLookup& key, const TypeCompare& compare)
+{
+    while (p)
+    {
+        int c = compare(key, p);
+        if (c == 0) return p;
+        p = c < 0 ? p->left : p->right;
+    }
+    return 0;
+}
+
+template <typename TypeNode, typename Func>
+void persistentForEach(const TypeNode* p, Func func)
+{
+    std::vector<const TypeNode*> stack;
+    while (p || !stack.empty())
+    {
+        while (p)
+        {
+            stack.push_back(p);
+            p = p->left;
+        }
+        p = stack.back();
+        stack.pop_back();
+        func(p->key, p->data);
+        p = p->right;
+    }
+}
+
+template <typename TypeKey, typename TypeData, typename TypeAlloc = std::allocator<std::pair<const TypeKey, TypeData>>, typename TypeCompare = keyCompare>
+class PersistentAVLTree
+{
+    typedef persistentNodeAVL<TypeKey, TypeData, TypeCompare> TypeNode;
+
+    persistentNodes<TypeNode, TypeAlloc> nodes;
+    TypeNode* root;
+    size_t numnode;
+    TypeCompare compare;
+
+    static int height(TypeNode* p)
+    {
+        return p ? p->height : 0;
+    }
+
+    static int balanceFactor(TypeNode* p)
+    {
+        return height(p->right) - height(p->left);
+    }
+
+    static void fixHeight(TypeNode* p)
+    {
+        int hl = height(p->left);
+        int hr = height(p->right);
+        p->height = (hl > hr ? hl : hr) + 1;
+    }
+
+    TypeNode* rotateRight(TypeNode* p)
+    {
+        TypeNode* q = nodes.unique(p->left);
+        p->left = q->right;
+        q->right = p;
+        fixHeight(p);
+        fixHeight(q);
+        return q;
+    }
+
+    TypeNode* rotateLeft(TypeNode* q)
+    {
+        TypeNode* p = nodes.unique(q->right);
+        q->right = p->left;
+        p->left = q;
+        fixHeight(q);
+        fixHeight(p);
+        return p;
+    }
+
+    TypeNode* balance(TypeNode* p)
+    {
+        fixHeight(p);
+        if (balanceFactor(p) == 2)
+        {
+            if (balanceFactor(p->right) < 0)
+                p->right = rotateRight(nodes.unique(p->right));
+            return rotateLeft(p);
+        }
+        if (balanceFactor(p) == -2)
+        {
+            if (balanceFactor(p->left) > 0)
+                p->left = rotateLeft(nodes.unique(p->left));
+            return rotateRight(p);
+        }
+        return p;
+    }
+
+    TypeNode* removeMin(TypeNode* p, TypeNode*& min)
+    {
+        p = nodes.unique(p);
+        if (!p->left)
+        {
+            TypeNode* r = p->right;
+            p->right = 0;
+            min = p;
+            return r;
+        }
+        p->left = removeMin(p->left, min);
+        return balance(p);
+    }
+
+    template <typename TypeLookup, typename TypeK, typename... Args>
+    TypeNode* insertElement(TypeNode* p, const TypeLookup& key, TypeK&& k, Args&&... d)
+    {
+        if (!p)
+        {
+            numnode++;
+            return nodes.create(std::forward<TypeK>(k), std::forward<Args>(d)...);
+        }
+        int c = compare(key, p);
+        p = nodes.unique(p);
+        if (c < 0)
+            p->left = insertElement(p->left, key, std::forward<TypeK>(k), std::forward<Args>(d)...);
+        else
+            p->right = insertElement(p->right, key, std::forward<TypeK>(k), std::forward<Args>(d)...);
+        return balance(p);
+    }
+
+    template <typename TypeLookup>
+    TypeNode* removeElement(TypeNode* p, const TypeLookup& key)
+    {
+        int c = compare(key, p);
+        if (c == 0)
+        {
+            TypeNode* l = nodes.acquire(p->left);
+            TypeNode* r = nodes.acquire(p->right);
+            nodes.release(p);
+            numnode--;
+            if (!r) return l;
+            TypeNode* min;
+            r = removeMin(r, min);
+            min->left = l;
+            min->right = r;
+            return balance(min);
+        }
+        p = nodes.unique(p);
+        if (c < 0)
+            p->left = removeElement(p->left, key);
+        else
+            p->right = removeElement(p->right, key);
+        return balance(p);
+    }
+public:
+    explicit PersistentAVLTree(const TypeAlloc& alloc_ = TypeAlloc(), const TypeCompare& compare_ = TypeCompare()) : nodes(alloc_), root(0), numnode(0), compare(compare_) {}
+
+    PersistentAVLTree(const PersistentAVLTree& other) : nodes(other.nodes), root(nodes.acquire(other.root)), numnode(other.numnode), compare(other.compare) {}
+
+    PersistentAVLTree(PersistentAVLTree&& other) : nodes(other.nodes), root(other.root), numnode(other.numnode), compare(other.compare)
+    {
+        other.root = 0;
+        other.numnode = 0;
+    }
+
+    PersistentAVLTree& operator=(PersistentAVLTree other)
+    {
+        std::swap(nodes, other.nodes);
+        std::swap(root, other.root);
+        std::swap(numnode, other.numnode);
+        std::swap(compare, other.compare);
+        return *this;
+    }
+
+    ~PersistentAVLTree() { clear(); }
+
+    PersistentAVLTree snapshot() const
+    {
+        return *this;
+    }
+
+    void insert(const std::pair<TypeKey, TypeData>& value)
+    {
+        emplace(value.first, value.second);
+    }
+
+    void insert(std::pair<TypeKey, TypeData>&& value)
+    {
+        emplace(std::move(value.first), std::move(value.second));
+    }
+
+    template <typename TypeK, typename... Args>
+    void emplace(TypeK&& key, Args&&... data)
+    {
+        typename compareProbe<TypeCompare, TypeKey, TypeK>::type q(key);
+        root = insertElement(root, q, std::forward<TypeK>(key), std::forward<Args>(data)...);
+    }
+
+    template <typename TypeK, typename... Args>
+    bool try_emplace(TypeK&& key, Args&&... data)
+    {
+        typename compareProbe<TypeCompare, TypeKey, TypeK>::type q(key);
+        if (persistentLookup(root, q, compare))
+            return false;
+        root = insertElement(root, q, std::forward<TypeK>(key), std::forward<Args>(data)...);
+        return true;
+    }
+
+    template <typename TypeLookup>
+    void erase(const TypeLookup& key)
+    {
+        typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type q(key);
+        if (persistentLookup(root, q, compare))
+            root = removeElement(root, q);
+    }
+
+    template <typename TypeLookup>
+    const TypeData* lookup(const TypeLookup& key) const
+    {
+        typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type q(key);
+        const TypeNode* p = persistentLookup(root, q, compare);
+        return p ? &p->data : 0;
+    }
+
+    template <typename TypeLookup>
+    TypeData find(const TypeLookup& key) const
+    {
+        const TypeData* data = lookup(key);
+        return data ? *data : TypeData();
+    }
+
+    template <typename TypeLookup>
+    bool contains(const TypeLookup& key) const
+    {
+        return lookup(key) != 0;
+    }
+
+    template <typename Func>
+    void for_each(Func func) const
+    {
+        persistentForEach(root, func);
+    }
+
+    size_t size() const
+    {
+        return numnode;
+    }
+
+    bool empty() const
+    {
+        return numnode == 0;
+    }
+
+    void clear()
+    {
+        nodes.release(root);
+        root = 0;
+        numnode = 0;
+    }
+};
+
+template <typename TypeKey, typename TypePriority, typename TypeData, typename TypeAlloc = std::allocator<std::pair<const TypeKey, TypeData>>, typename TypeCompare = keyCompare, typename TypePriorityGen = randomPriority>
+class PersistentTreapTree
+{
+    typedef persistentNodeTreap<TypeKey, TypePriority, TypeData, TypeCompare> TypeNode;
+
+    persistentNodes<TypeNode, TypeAlloc> nodes;
+    TypeNode* root;
+    size_t numnode;
+    TypeCompare compare;
+    TypePriorityGen generator;
+
+    TypeNode* merge(TypeNode* left, TypeNode* right)
+    {
+        if (!left) return right;
+        if (!right) return left;
+        if (left->priority < right->priority)
+        {
+            left = nodes.unique(left);
+            left->right = merge(left->right, right);
+            return left;
+        }
+        right = nodes.unique(right);
+        right->left = merge(left, right->left);
+        return right;
+    }
+
+    template <typename TypeLookup>
+    void split(TypeNode* p, const TypeLookup& key, TypeNode*& left, TypeNode*& right)
+    {
+        if (!p)
+        {
+            left = 0;
+            right = 0;
+            return;
+        }
+        p = nodes.unique(p);
+        if (compare(key, p) < 0)
+        {
+            split(p->left, key, left, p->left);
+            right = p;
+        }
+        else
+        {
+            split(p->right, key, p->right, right);
+            left = p;
+        }
+    }
+
+    template <typename TypeLookup>
+    TypeNode* insertElement(TypeNode* p, TypeNode* elem, const TypeLookup& key)
+    {
+        if (!p) return elem;
+        if (elem->priority < p->priority)
+        {
+            split(p, key, elem->left, elem->right);
+            return elem;
+        }
+        p = nodes.unique(p);
+        if (compare(key, p) > 0)
+            p->right = insertElement(p->right, elem, key);
+        else
+            p->left = insertElement(p->left, elem, key);
+        return p;
+    }
+
+    template <typename TypeLookup>
+    TypeNode* removeElement(TypeNode* p, const TypeLookup& key)
+    {
+        int c = compare(key, p);
+        if (c == 0)
+        {
+            TypeNode* l = nodes.acquire(p->left);
+            TypeNode* r = nodes.acquire(p->right);
+            nodes.release(p);
+            numnode--;
+            return merge(l, r);
+        }
+        p = nodes.unique(p);
+        if (c > 0)
+            p->right = removeElement(p->right, key);
+        else
+            p->left = removeElement(p->left, key);
+        return p;
+    }
+public:
+    explicit PersistentTreapTree(const TypeAlloc& alloc_ = TypeAlloc(), const TypeCompare& compare_ = TypeCompare(), const TypePriorityGen& generator_ = TypePriorityGen()) :
+        nodes(alloc_), root(0), numnode(0), compare(compare_), generator(generator_) {}
+
+    PersistentTreapTree(const PersistentTreapTree& other) :
+        nodes(other.nodes), root(nodes.acquire(other.root)), numnode(other.numnode), compare(other.compare), generator(other.generator) {}
+
+    PersistentTreapTree(PersistentTreapTree&& other) :
+        nodes(other.nodes), root(other.root), numnode(other.numnode), compare(other.compare), generator(other.generator)
+    {
+        other.root = 0;
+        other.numnode = 0;
+    }
+
+    PersistentTreapTree& operator=(PersistentTreapTree other)
+    {
+        std::swap(nodes, other.nodes);
+        std::swap(root, other.root);
+        std::swap(numnode, other.numnode);
+        std::swap(compare, other.compare);
+        std::swap(generator, other.generator);
+        return *this;
+    }
+
+    ~PersistentTreapTree() { clear(); }
+
+    PersistentTreapTree snapshot() const
+    {
+        return *this;
+    }
+
+    void insert(const TypeKey& key, const TypePriority& priority, const TypeData& value)
+    {
+        emplace(key, priority, value);
+    }
+
+    void insert(const std::pair<TypeKey, TypeData>& value)
+    {
+        emplace(value.first, generator.template next<TypePriority>(value.first), value.second);
+    }
+
+    void insert(std::pair<TypeKey, TypeData>&& value)
+    {
+        TypePriority priority = generator.template next<TypePriority>(value.first);
+        emplace(std::move(value.first), priority, std::move(value.second));
+    }
+
+    template <typename TypeK, typename... Args>
+    void emplace(TypeK&& key, const TypePriority& priority, Args&&... data)
+    {
+        TypeNode* elem = nodes.create(std::forward<TypeK>(key), priority, std::forward<Args>(data)...);
+        typename compareProbe<TypeCompare, TypeKey, TypeKey>::type q(elem->key);
+        root = insertElement(root, elem, q);
+        numnode++;
+    }
+
+    template <typename TypeK, typename... Args>
+    bool try_emplace(TypeK&& key, const TypePriority& priority, Args&&... data)
+    {
+        typename compareProbe<TypeCompare, TypeKey, TypeK>::type q(key);
+        if (persistentLookup(root, q, compare))
+            return false;
+        emplace(std::forward<TypeK>(key), priority, std::forward<Args>(data)...);
+        return true;
+    }
+
+    template <typename TypeLookup>
+    void erase(const TypeLookup& key)
+    {
+        typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type q(key);
+        if (persistentLookup(root, q, compare))
+            root = removeElement(root, q);
+    }
+
+    template <typename TypeLookup>
+    const TypeData* lookup(const TypeLookup& key) const
+    {
+        typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type q(key);
+        const TypeNode* p = persistentLookup(root, q, compare);
+        return p ? &p->data : 0;
+    }
+
+    template <typename TypeLookup>
+    TypeData find(const TypeLookup& key) const
+    {
+        const TypeData* data = lookup(key);
+        return data ? *data : TypeData();
+    }
+
+    template <typename TypeLookup>
+    bool contains(const TypeLookup& key) const
+    {
+        return lookup(key) != 0;
+    }
+
+    template <typename Func>
+    void for_each(Func func) const
+    {
+        persistentForEach(root, func);
+    }
+
+    size_t size() const
+    {
+        return numnode;
+    }
+
+    bool empty() const
+    {
+        return numnode == 0;
+    }
+
+    void clear()
+    {
+        nodes.release(root);
+        root = 0;
+        numnode = 0;
+    }
+};
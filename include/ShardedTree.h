@@ -0,0 +1,216 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+template <typename TypeKey>
+struct hashPartition
+{
+    size_t operator()(const TypeKey& key, size_t shards) const
+    {
+        uint64_t h = static_cast<uint64_t>(std::hash<TypeKey>()(key)) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>((h >> 32) % shards);
+    }
+};
+
+template <typename TypeKey>
+class rangePartition
+{
+    std::vector<TypeKey> bounds;
+public:
+    rangePartition() {}
+    explicit rangePartition(std::vector<TypeKey> bounds_) : bounds(std::move(bounds_))
+    {
+        std::sort(bounds.begin(), bounds.end());
+    }
+
+    size_t operator()(const TypeKey& key, size_t shards) const
+    {
+        size_t i = std::upper_bound(bounds.begin(), bounds.end(), key) - bounds.begin();
+        return i < shards ? i : shards - 1;
+    }
+};
+
+template <typename TypeTree, typename TypeKey, typename TypeData, typename TypePartition = hashPartition<TypeKey>>
+class ShardedTree
+{
+    struct shard
+    {
+        std::mutex lock;
+        TypeTree tree;
+    };
+
+    typedef std::pair<TypeKey, TypeData> TypeValue;
+
+    std::vector<std::unique_ptr<shard>> shards;
+    TypePartition partition;
+
+    shard& route(const TypeKey& key)
+    {
+        return *shards[partition(key, shards.size())];
+    }
+public:
+    // Walks all shards in key order by merging one cursor per shard through a
+    // heap of shard indices: begin() costs one descent per shard and each step
+    // O(log shards), with no copies of the elements. begin() locks every shard
+    // in index order and the locks are shared by all copies of the iterator;
+    // they are released when the last copy is destroyed. Writers block
+    // meanwhile, so the walk sees one consistent snapshot of the whole
+    // container, and the holder must not write to it until every copy is gone.
+    // end() takes no locks.
+    class const_iterator
+    {
+        friend class ShardedTree;
+
+        typedef typename TypeTree::const_iterator TypeCursor;
+        typedef std::vector<std::pair<TypeCursor, TypeCursor>> TypeCursors;
+
+        struct later
+        {
+            const TypeCursors& cursors;
+
+            bool operator()(size_t a, size_t b) const
+            {
+                return (*cursors[b].first).first < (*cursors[a].first).first;
+            }
+        };
+
+        std::shared_ptr<std::vector<std::unique_lock<std::mutex>>> locks;
+        TypeCursors cursors;
+        std::vector<size_t> heap;
+
+        explicit const_iterator(std::vector<std::unique_ptr<shard>>& shards) : locks(std::make_shared<std::vector<std::unique_lock<std::mutex>>>())
+        {
+            locks->reserve(shards.size());
+            for (size_t i = 0; i < shards.size(); ++i)
+            {
+                locks->emplace_back(shards[i]->lock);
+                const TypeTree& tree = shards[i]->tree;
+                cursors.push_back(std::make_pair(tree.begin(), tree.end()));
+                if (cursors[i].first != cursors[i].second)
+                    heap.push_back(i);
+            }
+            std::make_heap(heap.begin(), heap.end(), later{ cursors });
+        }
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef TypeValue value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef typename TypeCursor::pointer pointer;
+        typedef typename TypeCursor::reference reference;
+
+        const_iterator() {}
+
+        reference operator*() const { return *cursors[heap.front()].first; }
+        pointer operator->() const { return cursors[heap.front()].first.operator->(); }
+
+        const_iterator& operator++()
+        {
+            std::pop_heap(heap.begin(), heap.end(), later{ cursors });
+            std::pair<TypeCursor, TypeCursor>& cursor = cursors[heap.back()];
+            if (++cursor.first != cursor.second)
+                std::push_heap(heap.begin(), heap.end(), later{ cursors });
+            else
+                heap.pop_back();
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            const_iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        bool operator==(const const_iterator& other) const
+        {
+            if (heap.empty() || other.heap.empty())
+                return heap.empty() == other.heap.empty();
+            return locks == other.locks && cursors[heap.front()].first == other.cursors[other.heap.front()].first;
+        }
+
+        bool operator!=(const const_iterator& other) const
+        {
+            return !(*this == other);
+        }
+    };
+
+    explicit ShardedTree(size_t count, const TypePartition& partition_ = TypePartition()) : partition(partition_)
+    {
+        if (count == 0) count = 1;
+        for (size_t i = 0; i < count; ++i)
+            shards.push_back(std::unique_ptr<shard>(new shard()));
+    }
+
+    ShardedTree(const ShardedTree&) = delete;
+    ShardedTree& operator=(const ShardedTree&) = delete;
+
+    void insert(const TypeValue& value)
+    {
+        shard& s = route(value.first);
+        std::lock_guard<std::mutex> guard(s.lock);
+        s.tree.insert(value);
+    }
+
+    template <typename... Args>
+    void insert(const TypeKey& key, Args&&... args)
+    {
+        shard& s = route(key);
+        std::lock_guard<std::mutex> guard(s.lock);
+        s.tree.insert(key, std::forward<Args>(args)...);
+    }
+
+    void erase(const TypeKey& key)
+    {
+        shard& s = route(key);
+        std::lock_guard<std::mutex> guard(s.lock);
+        s.tree.erase(key);
+    }
+
+    TypeData find(const TypeKey& key)
+    {
+        shard& s = route(key);
+        std::lock_guard<std::mutex> guard(s.lock);
+        return s.tree.find(key);
+    }
+
+    template <typename Func>
+    void for_each(Func func)
+    {
+        for (const_iterator it = begin(), last = end(); it != last; ++it)
+        {
+            typename const_iterator::reference value = *it;
+            func(value.first, value.second);
+        }
+    }
+
+    const_iterator begin()
+    {
+        return const_iterator(shards);
+    }
+
+    const_iterator end()
+    {
+        return const_iterator();
+    }
+
+    size_t shardCount() const
+    {
+        return shards.size();
+    }
+
+    void clear()
+    {
+        for (size_t i = 0; i < shards.size(); ++i)
+        {
+            std::lock_guard<std::mutex> guard(shards[i]->lock);
+            shards[i]->tree.clear();
+        }
+    }
+};
@@ -0,0 +1,199 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define TREE_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define TREE_SIMD_X86 0
+#endif
+
+#if TREE_SIMD_X86 && (defined(__GNUC__) || defined(__clang__))
+#define TREE_TARGET_AVX2 __attribute__((target("avx2")))
+#define TREE_TARGET_SSE42 __attribute__((target("sse4.2")))
+#else
+#define TREE_TARGET_AVX2
+#define TREE_TARGET_SSE42
+#endif
+
+enum simdLevel
+{
+    simdScalar = 0,
+    simdSSE = 1,
+    simdAVX2 = 2
+};
+
+inline simdLevel detectSimdLevel()
+{
+#if TREE_SIMD_X86 && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    bool sse42 = (info[2] & (1 << 20)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    bool avx2 = false;
+    if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6)
+    {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+    if (avx2) return simdAVX2;
+    if (sse42) return simdSSE;
+#elif TREE_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return simdAVX2;
+    if (__builtin_cpu_supports("sse4.2")) return simdSSE;
+#endif
+    return simdScalar;
+}
+
+inline simdLevel& simdSearchLevel()
+{
+    static simdLevel level = detectSimdLevel();
+    return level;
+}
+
+inline void setSimdSearchLevel(simdLevel level)
+{
+    simdLevel supported = detectSimdLevel();
+    simdSearchLevel() = level < supported ? level : supported;
+}
+
+inline int countTrailingZeros(unsigned mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+inline int countTrailingZeros(unsigned long long mask)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return static_cast<int>(index);
+#elif defined(_MSC_VER)
+    unsigned low = static_cast<unsigned>(mask);
+    return low ? countTrailingZeros(low) : 32 + countTrailingZeros(static_cast<unsigned>(mask >> 32));
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+
+inline void prefetchRead(const void* p)
+{
+#if TREE_SIMD_X86 && defined(_MSC_VER)
+    _mm_prefetch(static_cast<const char*>(p), _MM_HINT_T0);
+#elif defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(p, 0, 3);
+#else
+    (void)p;
+#endif
+}
+
+#if TREE_SIMD_X86
+TREE_TARGET_AVX2 inline int lowerBoundAVX2(const int32_t* keys, int count, int32_t key)
+{
+    __m256i k = _mm256_set1_epi32(key);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(k, v))));
+        if (mask != 0xFF) return i + countTrailingZeros(~mask);
+    }
+    while (i < count && keys[i] < key)
+        ++i;
+    return i;
+}
+
+TREE_TARGET_AVX2 inline int lowerBoundAVX2(const int64_t* keys, int count, int64_t key)
+{
+    __m256i k = _mm256_set1_epi64x(key);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(k, v))));
+        if (mask != 0xF) return i + countTrailingZeros(~mask);
+    }
+    while (i < count && keys[i] < key)
+        ++i;
+    return i;
+}
+
+TREE_TARGET_SSE42 inline int lowerBoundSSE(const int32_t* keys, int count, int32_t key)
+{
+    __m128i k = _mm_set1_epi32(key);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(k, v))));
+        if (mask != 0xF) return i + countTrailingZeros(~mask);
+    }
+    while (i < count && keys[i] < key)
+        ++i;
+    return i;
+}
+
+TREE_TARGET_SSE42 inline int lowerBoundSSE(const int64_t* keys, int count, int64_t key)
+{
+    __m128i k = _mm_set1_epi64x(key);
+    int i = 0;
+    for (; i + 2 <= count; i += 2)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(k, v))));
+        if (mask != 0x3) return i + countTrailingZeros(~mask);
+    }
+    while (i < count && keys[i] < key)
+        ++i;
+    return i;
+}
+#endif
+
+template <typename TypeKey>
+struct keySearch
+{
+    static int lowerBound(const TypeKey* keys, int count, const TypeKey& key)
+    {
+        return static_cast<int>(std::lower_bound(keys, keys + count, key) - keys);
+    }
+};
+
+template <typename TypeInt>
+struct keySearchSimd
+{
+    static int lowerBound(const TypeInt* keys, int count, TypeInt key)
+    {
+#if TREE_SIMD_X86
+        switch (simdSearchLevel())
+        {
+        case simdAVX2:
+            return lowerBoundAVX2(keys, count, key);
+        case simdSSE:
+            return lowerBoundSSE(keys, count, key);
+        default:
+            break;
+        }
+#endif
+        return static_cast<int>(std::lower_bound(keys, keys + count, key) - keys);
+    }
+};
+
+template <>
+struct keySearch<int32_t> : keySearchSimd<int32_t> {};
+
+template <>
+struct keySearch<int64_t> : keySearchSimd<int64_t> {};
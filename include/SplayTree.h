@@ -1,40 +1,100 @@
 #pragma once
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <type_traits>
 #include <vector>
+#include "NodePool.h"
+#include "TreeBatch.h"
+#include "TreeStats.h"
+#include "TreeIterator.h"
+#include "OrderStatistics.h"
+#include "KeyCompare.h"
+#include "TreeImage.h"
 
-template <typename TypeKey, typename TypeData>
-struct nodeSplay
+template <typename TypeKey, typename TypeData, typename TypeOrder = noOrderStatistics, typename TypeCompare = keyCompare>
+struct nodeSplay : TypeOrder::nodeAugment, TypeCompare::nodeCache
 {
     TypeKey key;
     TypeData data;
 
-    nodeSplay<TypeKey, TypeData>* left;
-    nodeSplay<TypeKey, TypeData>* right;
-    nodeSplay<TypeKey, TypeData>* parent;
+    nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* left;
+    nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* right;
+    nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* parent;
 
-    nodeSplay(const TypeKey& k, const TypeData& d) : key(k), data(d), left(0), right(0), parent(0) {}
-    nodeSplay(const TypeKey& k, const TypeData& d, nodeSplay<TypeKey, TypeData>* l, nodeSplay<TypeKey, TypeData>* r) : key(k), data(d), left(l), right(r), parent(0) {}
+    template <typename TypeK, typename... Args>
+    nodeSplay(TypeK&& k, Args&&... d) : key(std::forward<TypeK>(k)), data(std::forward<Args>(d)...), left(0), right(0), parent(0)
+    {
+        this->cacheKey(key);
+        TypeOrder::update(this);
+    }
 };
 
-template <typename TypeKey, typename TypeData>
+template <typename TypeKey, typename TypeData, typename TypeAlloc = std::allocator<std::pair<const TypeKey, TypeData>>, typename TypeStats = noTreeStats, typename TypeOrder = noOrderStatistics, typename TypeCompare = keyCompare>
 class SplayTree
 {
-    nodeSplay<TypeKey, TypeData>* root;
+    typedef typename std::allocator_traits<TypeAlloc>::template rebind_alloc<nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>> TypeNodeAlloc;
+    typedef std::allocator_traits<TypeNodeAlloc> TypeNodeTraits;
+
+    TypeNodeAlloc alloc;
+    nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* root;
+    bool iterative;
+    TypeStats stats;
+    TypeCompare compare;
+
+    typedef typename compareProbe<TypeCompare, TypeKey, TypeKey>::type TypeKeyProbe;
+
+    template <typename TypeK, typename... Args>
+    nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* createNode(nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* left, nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* right, TypeK&& key, Args&&... data)
+    {
+        nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* p = TypeNodeTraits::allocate(alloc, 1);
+        try
+        {
+            TypeNodeTraits::construct(alloc, p, std::forward<TypeK>(key), std::forward<Args>(data)...);
+        }
+        catch (...)
+        {
+            TypeNodeTraits::deallocate(alloc, p, 1);
+            throw;
+        }
+        p->left = left;
+        p->right = right;
+        return p;
+    }
+
+    template <typename TypeArg>
+    static void assignData(TypeData& data, TypeArg&& value)
+    {
+        data = std::forward<TypeArg>(value);
+    }
+
+    template <typename... Args>
+    static void assignData(TypeData& data, Args&&... args)
+    {
+        data = TypeData(std::forward<Args>(args)...);
+    }
+
+    void destroyNode(nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* p)
+    {
+        TypeNodeTraits::destroy(alloc, p);
+        TypeNodeTraits::deallocate(alloc, p, 1);
+    }
 
-    void setParent(nodeSplay<TypeKey, TypeData>* child, nodeSplay<TypeKey, TypeData>* parent)
+    void setParent(nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* child, nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* parent)
     {
         if (!child) return;
         child->parent = parent;
     }
 
-    void keepParent(nodeSplay<TypeKey, TypeData>* p)
+    void keepParent(nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* p)
     {
         setParent(p->left, p);
         setParent(p->right, p);
     }
 
-    void rotate(nodeSplay<TypeKey, TypeData>* parent, nodeSplay<TypeKey, TypeData>* child)
+    void rotate(nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* parent, nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* child)
     {
-        nodeSplay<TypeKey, TypeData>* gparent = parent->parent;
+        nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* gparent = parent->parent;
         if (gparent)
         {
             if (gparent->left == parent)
@@ -57,13 +117,17 @@ class SplayTree
         keepParent(child);
         keepParent(parent);
         child->parent = gparent;
+        TypeOrder::update(parent);
+        TypeOrder::update(child);
+        stats.rotate();
     }
 
-    nodeSplay<TypeKey, TypeData>* splay(nodeSplay<TypeKey, TypeData>* v)
+    nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* splay(nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* v)
     {
         if (!(v->parent)) return v;
-        nodeSplay<TypeKey, TypeData>* parent = v->parent;
-        nodeSplay<TypeKey, TypeData>* gparent = parent->parent;
+        nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* parent = v->parent;
+        nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* gparent = parent->parent;
+        stats.restructure();
         if (!gparent)
         {
             rotate(parent, v);
@@ -86,111 +150,533 @@ class SplayTree
         }
     }
 
-    nodeSplay<TypeKey, TypeData>* findElement(nodeSplay<TypeKey, TypeData>* v, const TypeKey& key)
+    template <typename TypeProbe>
+    nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* findElement(nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* v, const TypeProbe& key, int& c)
     {
         if (!v) return 0;
-        if (key == v->key)
+        stats.compare();
+        c = compare(key, v);
+        if (c < 0 && v->left)
         {
-            return splay(v);
+            return findElement(v->left, key, c);
+        }
+        if (c > 0 && v->right)
+        {
+            return findElement(v->right, key, c);
+        }
+        return splay(v);
+    }
+
+    template <typename TypeProbe>
+    nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* splayTopDown(nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* t, const TypeProbe& key, int& c)
+    {
+        if (!t) return 0;
+        nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* leftRoot = 0;
+        nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* leftMax = 0;
+        nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* rightRoot = 0;
+        nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* rightMin = 0;
+        stats.compare();
+        c = compare(key, t);
+        while (c != 0)
+        {
+            if (c < 0)
+            {
+                if (!t->left) break;
+                stats.compare();
+                c = compare(key, t->left);
+                if (c < 0)
+                {
+                    nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* q = t->left;
+                    t->left = q->right;
+                    setParent(t->left, t);
+                    q->right = t;
+                    t->parent = q;
+                    TypeOrder::update(t);
+                    t = q;
+                    stats.rotate();
+                    if (!t->left) break;
+                }
+                if (rightMin)
+                {
+                    rightMin->left = t;
+                    t->parent = rightMin;
+                }
+                else
+                    rightRoot = t;
+                rightMin = t;
+                stats.restructure();
+                t = t->left;
+                if (c < 0)
+                {
+                    stats.compare();
+                    c = compare(key, t);
+                }
+            }
+            else
+            {
+                if (!t->right) break;
+                stats.compare();
+                c = compare(key, t->right);
+                if (c > 0)
+                {
+                    nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* q = t->right;
+                    t->right = q->left;
+                    setParent(t->right, t);
+                    q->left = t;
+                    t->parent = q;
+                    TypeOrder::update(t);
+                    t = q;
+                    stats.rotate();
+                    if (!t->right) break;
+                }
+                if (leftMax)
+                {
+                    leftMax->right = t;
+                    t->parent = leftMax;
+                }
+                else
+                    leftRoot = t;
+                leftMax = t;
+                stats.restructure();
+                t = t->right;
+                if (c > 0)
+                {
+                    stats.compare();
+                    c = compare(key, t);
+                }
+            }
         }
-        if ((key < v->key) && (v->left))
+        if (leftMax)
         {
-            return findElement(v->left, key);
+            leftMax->right = t->left;
+            setParent(t->left, leftMax);
+            t->left = leftRoot;
+            leftRoot->parent = t;
+            for (nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* p = leftMax; TypeOrder::enabled && p != t; p = p->parent)
+                TypeOrder::update(p);
         }
-        if ((key > v->key) && (v->right))
+        if (rightMin)
         {
-            return findElement(v->right, key);
+            rightMin->left = t->right;
+            setParent(t->right, rightMin);
+            t->right = rightRoot;
+            rightRoot->parent = t;
+            for (nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* p = rightMin; TypeOrder::enabled && p != t; p = p->parent)
+                TypeOrder::update(p);
         }
-        return splay(v);
+        t->parent = 0;
+        TypeOrder::update(t);
+        return t;
     }
 
-    std::pair<nodeSplay<TypeKey, TypeData>*, nodeSplay<TypeKey, TypeData>*> split(nodeSplay<TypeKey, TypeData>* proot, const TypeKey& key)
+
+    template <typename TypeProbe>
+    nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* searchElement(nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* v, const TypeProbe& key, int& c)
+    {
+        return iterative ? splayTopDown(v, key, c) : findElement(v, key, c);
+    }
+
+    std::pair<nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>*, nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>*> split(nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* proot, int c)
     {
         if (!proot) return { 0, 0 };
-        proot = findElement(proot, key);
-        if (proot->key == key)
+        if (c == 0)
         {
             setParent(proot->left, 0);
             setParent(proot->right, 0);
             return { proot->left, proot->right };
         }
-        if (proot->key < key)
+        if (c > 0)
         {
-            nodeSplay<TypeKey, TypeData>* right = proot->right;
+            nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* right = proot->right;
             proot->right = 0;
+            TypeOrder::update(proot);
             setParent(right, 0);
             return { proot, right };
         }
         else
         {
-            nodeSplay<TypeKey, TypeData>* left = proot->left;
+            nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* left = proot->left;
             proot->left = 0;
+            TypeOrder::update(proot);
             setParent(left, 0);
             return { left, proot };
         }
     }
 
-    nodeSplay<TypeKey, TypeData>* insertElement(nodeSplay<TypeKey, TypeData>* proot, const TypeKey& key, const TypeData& data)
+    template <typename TypeProbe, typename TypeK, typename... Args>
+    nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* insertElement(nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* proot, bool unique, bool& inserted, const TypeProbe& q, TypeK&& key, Args&&... data)
     {
-        std::pair<nodeSplay<TypeKey, TypeData>*, nodeSplay<TypeKey, TypeData>*> childs = split(proot, key);
-        proot = new nodeSplay<TypeKey, TypeData>(key, data, childs.first, childs.second);
+        int c = 0;
+        if (proot)
+        {
+            proot = searchElement(proot, q, c);
+            if (c == 0)
+            {
+                if (!unique)
+                {
+                    assignData(proot->data, std::forward<Args>(data)...);
+                    TypeOrder::update(proot);
+                }
+                return proot;
+            }
+        }
+        std::pair<nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>*, nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>*> childs = split(proot, c);
+        proot = createNode(childs.first, childs.second, std::forward<TypeK>(key), std::forward<Args>(data)...);
+        inserted = true;
         keepParent(proot);
+        TypeOrder::update(proot);
         return proot;
     }
 
-    nodeSplay<TypeKey, TypeData>* merge(nodeSplay<TypeKey, TypeData>* left, nodeSplay<TypeKey, TypeData>* right)
+    nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* merge(nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* left, nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* right)
     {
         if (!right) return left;
         if (!left) return right;
-        right = findElement(right, left->key);
+        int c;
+        right = searchElement(right, TypeKeyProbe(left->key), c);
         right->left = left;
         left->parent = right;
+        TypeOrder::update(right);
         return right;
     }
 
-    nodeSplay<TypeKey, TypeData>* removeElement(nodeSplay<TypeKey, TypeData>* proot, const TypeKey& key)
+    template <typename TypeProbe>
+    nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* removeElement(nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* proot, const TypeProbe& key)
     {
-        proot = findElement(proot, key);
-        nodeSplay<TypeKey, TypeData>* left = proot->left;
-        nodeSplay<TypeKey, TypeData>* right = proot->right;
-        delete proot;
+        if (!proot) return 0;
+        int c;
+        proot = searchElement(proot, key, c);
+        if (c != 0) return proot;
+        nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* left = proot->left;
+        nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* right = proot->right;
+        destroyNode(proot);
         setParent(left, 0);
         setParent(right, 0);
         return merge(left, right);
     }
 
-    void clearElement(nodeSplay<TypeKey, TypeData>* p)
+    template <typename Iterator>
+    nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* buildElement(Iterator& it, size_t n)
+    {
+        if (n == 0) return 0;
+        nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* left = buildElement(it, n / 2);
+        nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* p = createNode(left, 0, it->first, it->second);
+        ++it;
+        p->right = buildElement(it, n - n / 2 - 1);
+        keepParent(p);
+        TypeOrder::update(p);
+        return p;
+    }
+
+    void clearElement(nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* p)
     {
-        if (!p) return;
-        nodeSplay<TypeKey, TypeData>* q = p->left;
-        nodeSplay<TypeKey, TypeData>* r = p->right;
-        delete p;
-        if (!q) clearElement(q);
-        if (!r) clearElement(r);
+        std::vector<nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>*> stack;
+        if (p) stack.push_back(p);
+        while (!stack.empty())
+        {
+            p = stack.back();
+            stack.pop_back();
+            if (p->left) stack.push_back(p->left);
+            if (p->right) stack.push_back(p->right);
+            destroyNode(p);
+        }
     }
 public:
-    SplayTree() : root(0) {}
+    explicit SplayTree(const TypeAlloc& alloc_ = TypeAlloc(), const TypeCompare& compare_ = TypeCompare()) : alloc(alloc_), root(0), iterative(true), compare(compare_) {}
     ~SplayTree() { clear(); }
 
     void insert(const std::pair<TypeKey, TypeData>& value)
     {
-        root = insertElement(root, value.first, value.second);
+        emplace(value.first, value.second);
+    }
+
+    void insert(std::pair<TypeKey, TypeData>&& value)
+    {
+        emplace(std::move(value.first), std::move(value.second));
+    }
+
+    template <typename TypeK, typename... Args>
+    void emplace(TypeK&& key, Args&&... data)
+    {
+        stats.begin(treeInsert);
+        typename compareProbe<TypeCompare, TypeKey, TypeK>::type q(key);
+        bool inserted = false;
+        root = insertElement(root, false, inserted, q, std::forward<TypeK>(key), std::forward<Args>(data)...);
+    }
+
+    template <typename TypeK, typename... Args>
+    bool try_emplace(TypeK&& key, Args&&... data)
+    {
+        stats.begin(treeInsert);
+        typename compareProbe<TypeCompare, TypeKey, TypeK>::type q(key);
+        bool inserted = false;
+        root = insertElement(root, true, inserted, q, std::forward<TypeK>(key), std::forward<Args>(data)...);
+        return inserted;
+    }
+
+    typedef parentIterator<nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>, TypeKey, TypeData> iterator;
+    typedef parentIterator<nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>, TypeKey, const TypeData> const_iterator;
+
+    iterator begin()
+    {
+        return iterator::first(&root);
+    }
+
+    iterator end()
+    {
+        return iterator(&root);
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator::first(&root);
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator(&root);
+    }
+
+    template <typename TypeLookup>
+    iterator lower_bound(const TypeLookup& key)
+    {
+        typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type q(key);
+        return iterator::bound(&root, [this, &q](const nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* p) { return compare(q, p) > 0; });
+    }
+
+    template <typename TypeLookup>
+    iterator upper_bound(const TypeLookup& key)
+    {
+        typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type q(key);
+        return iterator::bound(&root, [this, &q](const nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* p) { return compare(q, p) >= 0; });
+    }
+
+    template <typename TypeLookup>
+    const_iterator lower_bound(const TypeLookup& key) const
+    {
+        typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type q(key);
+        return const_iterator::bound(&root, [this, &q](const nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* p) { return compare(q, p) > 0; });
+    }
+
+    template <typename TypeLookup>
+    const_iterator upper_bound(const TypeLookup& key) const
+    {
+        typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type q(key);
+        return const_iterator::bound(&root, [this, &q](const nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* p) { return compare(q, p) >= 0; });
+    }
+
+    template <typename TypeLookup>
+    std::pair<iterator, iterator> equal_range(const TypeLookup& key)
+    {
+        return std::make_pair(lower_bound(key), upper_bound(key));
+    }
+
+    template <typename TypeLookup>
+    std::pair<const_iterator, const_iterator> equal_range(const TypeLookup& key) const
+    {
+        return std::make_pair(lower_bound(key), upper_bound(key));
+    }
+
+    template <typename TypeLookup>
+    size_t rank(const TypeLookup& key) const
+    {
+        static_assert(TypeOrder::enabled, "rank needs orderStatistics");
+        typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type q(key);
+        return rankElement<TypeOrder>(root, compare, q);
+    }
+
+    iterator select(size_t k)
+    {
+        static_assert(TypeOrder::enabled, "select needs orderStatistics");
+        return selectElement<TypeOrder, iterator>(&root, k);
+    }
+
+    const_iterator select(size_t k) const
+    {
+        static_assert(TypeOrder::enabled, "select needs orderStatistics");
+        return selectElement<TypeOrder, const_iterator>(&root, k);
+    }
+
+    template <typename TypeLookup>
+    size_t count_range(const TypeLookup& lo, const TypeLookup& hi) const
+    {
+        size_t first = rank(lo);
+        size_t last = rank(hi);
+        return last > first ? last - first : 0;
+    }
+
+    template <typename TypeLookup, typename Func>
+    void for_each_in_range(const TypeLookup& lo, const TypeLookup& hi, Func func) const
+    {
+        for (const_iterator it = lower_bound(lo), last = end(); it != last; ++it)
+        {
+            typename const_iterator::reference value = *it;
+            if (compare(value.first, hi) >= 0) break;
+            func(value.first, value.second);
+        }
+    }
+
+    template <typename TypeLookup, typename TypeAggregate = TypeOrder>
+    typename TypeAggregate::value_type aggregate(const TypeLookup& lo, const TypeLookup& hi) const
+    {
+        typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type qlo(lo);
+        typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type qhi(hi);
+        return aggregateElement<TypeAggregate>(root, compare, qlo, qhi);
+    }
+
+    template <typename TypeLookup, typename Func>
+    bool update(const TypeLookup& key, Func func)
+    {
+        stats.begin(treeFind);
+        typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type q(key);
+        int c = 0;
+        root = searchElement(root, q, c);
+        if (!root || c != 0) return false;
+        func(root->data);
+        TypeOrder::update(root);
+        return true;
+    }
+
+    template <typename Iterator>
+    void build(Iterator first, Iterator last)
+    {
+        clear();
+        stats.begin(treeBulk);
+        root = buildElement(first, std::distance(first, last));
+    }
+
+    void build(std::vector<std::pair<TypeKey, TypeData>> elements)
+    {
+        std::stable_sort(elements.begin(), elements.end(),
+            [this](const std::pair<TypeKey, TypeData>& a, const std::pair<TypeKey, TypeData>& b) { return compare(a.first, b.first) < 0; });
+        build(elements.begin(), elements.end());
+    }
+
+    bool save(const std::string& path) const
+    {
+        treeImageWriter<TypeKey, TypeData> image;
+        for_each([&image](const TypeKey& key, const TypeData& data) { image.add(key, data); });
+        return image.write(path);
     }
 
-    void erase(const TypeKey& key)
+    bool load(const std::string& path)
     {
-        root = removeElement(root, key);
+        treeImageView<TypeKey, TypeData, TypeCompare> image(compare);
+        if (!image.open(path)) return false;
+        build(image.begin(), image.end());
+        return true;
     }
 
-    TypeData find(const TypeKey& key)
+    void insert_batch(std::vector<std::pair<TypeKey, TypeData>> batch)
     {
-        root = findElement(root, key);
-        return root->data;
+        stats.begin(treeBulk);
+        prepareBatch(batch, compare);
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            TypeKeyProbe q(batch[i].first);
+            bool inserted = false;
+            root = insertElement(root, false, inserted, q, std::move(batch[i].first), std::move(batch[i].second));
+        }
+    }
+
+    void erase_batch(std::vector<TypeKey> keys)
+    {
+        stats.begin(treeBulk);
+        prepareBatch(keys, compare);
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            root = removeElement(root, TypeKeyProbe(keys[i]));
+        }
+    }
+
+    std::vector<TypeData> find_batch(const std::vector<TypeKey>& keys)
+    {
+        stats.begin(treeBulk);
+        std::vector<TypeData> result(keys.size());
+        std::vector<size_t> order = orderBatch(keys, compare);
+        for (size_t i = 0; i < order.size() && root; ++i)
+        {
+            int c;
+            root = searchElement(root, TypeKeyProbe(keys[order[i]]), c);
+            if (c == 0)
+                result[order[i]] = root->data;
+        }
+        return result;
+    }
+
+    template <typename TypeLookup>
+    void erase(const TypeLookup& key)
+    {
+        stats.begin(treeErase);
+        root = removeElement(root, typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type(key));
+    }
+
+    template <typename TypeLookup>
+    TypeData find(const TypeLookup& key)
+    {
+        stats.begin(treeFind);
+        if (!root) return TypeData();
+        int c;
+        root = searchElement(root, typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type(key), c);
+        return c == 0 ? root->data : TypeData();
+    }
+
+    template <typename TypeLookup>
+    bool contains(const TypeLookup& key)
+    {
+        stats.begin(treeFind);
+        if (!root) return false;
+        int c;
+        root = searchElement(root, typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type(key), c);
+        return c == 0;
+    }
+
+    void setIterative(bool value)
+    {
+        iterative = value;
+    }
+
+    bool isIterative() const
+    {
+        return iterative;
+    }
+
+    const TypeStats& getStats() const
+    {
+        return stats;
+    }
+
+    treeShape getShape() const
+    {
+        return measureShape(root);
+    }
+
+    template <typename Func>
+    void for_each(Func func) const
+    {
+        std::vector<nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>*> stack;
+        nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>* p = root;
+        while (p || !stack.empty())
+        {
+            while (p)
+            {
+                stack.push_back(p);
+                p = p->left;
+            }
+            p = stack.back();
+            stack.pop_back();
+            func(p->key, p->data);
+            p = p->right;
+        }
     }
 
     void clear()
     {
-        clearElement(root);
+        bool bulk = allocatorRelease<TypeNodeAlloc>::exclusive(alloc);
+        if (!bulk || !std::is_trivially_destructible<nodeSplay<TypeKey, TypeData, TypeOrder, TypeCompare>>::value)
+            clearElement(root);
+        if (bulk)
+            allocatorRelease<TypeNodeAlloc>::release(alloc);
         root = 0;
     }
 };
\ No newline at end of file
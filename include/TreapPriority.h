@@ -0,0 +1,57 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <type_traits>
+
+inline uint64_t mixPriority(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+template <typename TypePriority>
+TypePriority scalePriority(uint64_t x)
+{
+    static_assert(std::is_integral<TypePriority>::value, "generated priorities must be integral");
+    return static_cast<TypePriority>(x >> (64 - std::numeric_limits<TypePriority>::digits));
+}
+
+inline uint64_t prioritySeed()
+{
+    static std::atomic<uint64_t> counter(0x9e3779b97f4a7c15ull);
+    return mixPriority(counter.fetch_add(0x9e3779b97f4a7c15ull, std::memory_order_relaxed));
+}
+
+struct randomPriority
+{
+    uint64_t state;
+
+    explicit randomPriority(uint64_t seed = prioritySeed()) : state(seed ? seed : 1) {}
+
+    template <typename TypePriority, typename TypeKey>
+    TypePriority next(const TypeKey&)
+    {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return scalePriority<TypePriority>(state * 0x2545f4914f6cdd1dull);
+    }
+};
+
+struct hashPriority
+{
+    uint64_t seed;
+
+    explicit hashPriority(uint64_t seed_ = 0) : seed(seed_) {}
+
+    template <typename TypePriority, typename TypeKey>
+    TypePriority next(const TypeKey& key)
+    {
+        return scalePriority<TypePriority>(mixPriority(std::hash<TypeKey>()(key) ^ seed));
+    }
+};
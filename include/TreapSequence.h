@@ -0,0 +1,374 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "TreapPriority.h"
+
+template <typename TypeValue>
+struct nodeSequence
+{
+    TypeValue value;
+    size_t size;
+    uint32_t priority;
+    bool reversed;
+
+    nodeSequence<TypeValue>* left;
+    nodeSequence<TypeValue>* right;
+
+    template <typename... Args>
+    nodeSequence(uint32_t priority_, Args&&... value_) : value(std::forward<Args>(value_)...), size(1), priority(priority_), reversed(false), left(0), right(0) {}
+};
+
+template <typename TypeValue, typename TypeAlloc = std::allocator<TypeValue>>
+class TreapSequence
+{
+    typedef typename std::allocator_traits<TypeAlloc>::template rebind_alloc<nodeSequence<TypeValue>> TypeNodeAlloc;
+    typedef std::allocator_traits<TypeNodeAlloc> TypeNodeTraits;
+
+    TypeNodeAlloc alloc;
+    nodeSequence<TypeValue>* root;
+    randomPriority generator;
+
+    template <typename... Args>
+    nodeSequence<TypeValue>* createNode(Args&&... value)
+    {
+        nodeSequence<TypeValue>* p = TypeNodeTraits::allocate(alloc, 1);
+        try
+        {
+            TypeNodeTraits::construct(alloc, p, generator.next<uint32_t>(0), std::forward<Args>(value)...);
+        }
+        catch (...)
+        {
+            TypeNodeTraits::deallocate(alloc, p, 1);
+            throw;
+        }
+        return p;
+    }
+
+    void clearElement(nodeSequence<TypeValue>* p)
+    {
+        std::vector<nodeSequence<TypeValue>*> stack;
+        if (p) stack.push_back(p);
+        while (!stack.empty())
+        {
+            p = stack.back();
+            stack.pop_back();
+            if (p->left) stack.push_back(p->left);
+            if (p->right) stack.push_back(p->right);
+            TypeNodeTraits::destroy(alloc, p);
+            TypeNodeTraits::deallocate(alloc, p, 1);
+        }
+    }
+
+    static size_t sizeOf(const nodeSequence<TypeValue>* p)
+    {
+        return p ? p->size : 0;
+    }
+
+    static void update(nodeSequence<TypeValue>* p)
+    {
+        p->size = 1 + sizeOf(p->left) + sizeOf(p->right);
+    }
+
+    static void push(nodeSequence<TypeValue>* p)
+    {
+        if (!p->reversed)
+            return;
+        std::swap(p->left, p->right);
+        if (p->left)
+            p->left->reversed = !p->left->reversed;
+        if (p->right)
+            p->right->reversed = !p->right->reversed;
+        p->reversed = false;
+    }
+
+    static nodeSequence<TypeValue>* merge(nodeSequence<TypeValue>* left, nodeSequence<TypeValue>* right)
+    {
+        if (!left) return right;
+        if (!right) return left;
+        if (left->priority < right->priority)
+        {
+            push(left);
+            left->right = merge(left->right, right);
+            update(left);
+            return left;
+        }
+        push(right);
+        right->left = merge(left, right->left);
+        update(right);
+        return right;
+    }
+
+    static void split(nodeSequence<TypeValue>* p, size_t index, nodeSequence<TypeValue>*& left, nodeSequence<TypeValue>*& right)
+    {
+        if (!p)
+        {
+            left = 0;
+            right = 0;
+            return;
+        }
+        push(p);
+        if (sizeOf(p->left) < index)
+        {
+            split(p->right, index - sizeOf(p->left) - 1, p->right, right);
+            left = p;
+        }
+        else
+        {
+            split(p->left, index, left, p->left);
+            right = p;
+        }
+        update(p);
+    }
+
+    template <typename Iterator>
+    nodeSequence<TypeValue>* buildElement(Iterator first, Iterator last)
+    {
+        std::vector<nodeSequence<TypeValue>*> spine;
+        for (; first != last; ++first)
+        {
+            nodeSequence<TypeValue>* elem = createNode(*first);
+            nodeSequence<TypeValue>* child = 0;
+            while (!spine.empty() && elem->priority < spine.back()->priority)
+            {
+                child = spine.back();
+                update(child);
+                spine.pop_back();
+            }
+            elem->left = child;
+            if (!spine.empty())
+                spine.back()->right = elem;
+            spine.push_back(elem);
+        }
+        for (size_t i = spine.size(); i-- > 0; )
+            update(spine[i]);
+        return spine.empty() ? 0 : spine.front();
+    }
+
+    nodeSequence<TypeValue>* findElement(size_t index) const
+    {
+        nodeSequence<TypeValue>* p = root;
+        bool flip = false;
+        for (;;)
+        {
+            flip = flip != p->reversed;
+            nodeSequence<TypeValue>* l = flip ? p->right : p->left;
+            size_t s = sizeOf(l);
+            if (index == s)
+                return p;
+            if (index < s)
+                p = l;
+            else
+            {
+                index -= s + 1;
+                p = flip ? p->left : p->right;
+            }
+        }
+    }
+
+    nodeSequence<TypeValue>* takeElements(TreapSequence& other)
+    {
+        nodeSequence<TypeValue>* q;
+        if (alloc == other.alloc)
+        {
+            q = other.root;
+            other.root = 0;
+        }
+        else
+        {
+            std::vector<TypeValue> values;
+            values.reserve(other.size());
+            other.for_each([&values](const TypeValue& value) { values.push_back(value); });
+            q = buildElement(values.begin(), values.end());
+            other.clear();
+        }
+        return q;
+    }
+
+    TreapSequence(const TypeNodeAlloc& alloc_, nodeSequence<TypeValue>* root_, const randomPriority& generator_) : alloc(alloc_), root(root_), generator(generator_) {}
+
+    void insertElement(size_t index, nodeSequence<TypeValue>* elem)
+    {
+        nodeSequence<TypeValue>* left;
+        nodeSequence<TypeValue>* right;
+        split(root, index, left, right);
+        root = merge(merge(left, elem), right);
+    }
+public:
+    explicit TreapSequence(const TypeAlloc& alloc_ = TypeAlloc()) : alloc(alloc_), root(0) {}
+
+    template <typename Iterator>
+    TreapSequence(Iterator first, Iterator last, const TypeAlloc& alloc_ = TypeAlloc()) : alloc(alloc_), root(0)
+    {
+        root = buildElement(first, last);
+    }
+
+    TreapSequence(const TreapSequence&) = delete;
+    TreapSequence& operator=(const TreapSequence&) = delete;
+
+    TreapSequence(TreapSequence&& other) : alloc(other.alloc), root(other.root), generator(other.generator)
+    {
+        other.root = 0;
+        other.generator = randomPriority();
+    }
+
+    TreapSequence& operator=(TreapSequence&& other)
+    {
+        std::swap(alloc, other.alloc);
+        std::swap(root, other.root);
+        std::swap(generator, other.generator);
+        return *this;
+    }
+
+    ~TreapSequence() { clear(); }
+
+    template <typename Iterator>
+    void assign(Iterator first, Iterator last)
+    {
+        clear();
+        root = buildElement(first, last);
+    }
+
+    size_t size() const
+    {
+        return sizeOf(root);
+    }
+
+    bool empty() const
+    {
+        return root == 0;
+    }
+
+    TypeValue& operator[](size_t index)
+    {
+        return findElement(index)->value;
+    }
+
+    const TypeValue& operator[](size_t index) const
+    {
+        return findElement(index)->value;
+    }
+
+    TypeValue& at(size_t index)
+    {
+        if (index >= size())
+            throw std::out_of_range("sequence index out of range");
+        return findElement(index)->value;
+    }
+
+    const TypeValue& at(size_t index) const
+    {
+        if (index >= size())
+            throw std::out_of_range("sequence index out of range");
+        return findElement(index)->value;
+    }
+
+    template <typename... Args>
+    void emplace(size_t index, Args&&... value)
+    {
+        insertElement(index, createNode(std::forward<Args>(value)...));
+    }
+
+    void insert(size_t index, const TypeValue& value)
+    {
+        emplace(index, value);
+    }
+
+    void insert(size_t index, TypeValue&& value)
+    {
+        emplace(index, std::move(value));
+    }
+
+    template <typename Iterator>
+    void insert(size_t index, Iterator first, Iterator last)
+    {
+        insertElement(index, buildElement(first, last));
+    }
+
+    void push_back(const TypeValue& value)
+    {
+        root = merge(root, createNode(value));
+    }
+
+    void push_front(const TypeValue& value)
+    {
+        root = merge(createNode(value), root);
+    }
+
+    void erase(size_t index)
+    {
+        erase(index, index + 1);
+    }
+
+    void erase(size_t first, size_t last)
+    {
+        slice(first, last).clear();
+    }
+
+    TreapSequence slice(size_t first, size_t last)
+    {
+        nodeSequence<TypeValue>* left;
+        nodeSequence<TypeValue>* middle;
+        nodeSequence<TypeValue>* right;
+        split(root, last, left, right);
+        split(left, first, left, middle);
+        root = merge(left, right);
+        return TreapSequence(alloc, middle, randomPriority(generator.next<uint64_t>(0)));
+    }
+
+    void splice(size_t index, TreapSequence& other)
+    {
+        if (&other == this) return;
+        insertElement(index, takeElements(other));
+    }
+
+    void append(TreapSequence& other)
+    {
+        if (&other == this) return;
+        root = merge(root, takeElements(other));
+    }
+
+    void reverse(size_t first, size_t last)
+    {
+        nodeSequence<TypeValue>* left;
+        nodeSequence<TypeValue>* middle;
+        nodeSequence<TypeValue>* right;
+        split(root, last, left, right);
+        split(left, first, left, middle);
+        if (middle)
+            middle->reversed = !middle->reversed;
+        root = merge(merge(left, middle), right);
+    }
+
+    template <typename Func>
+    void for_each(Func func) const
+    {
+        std::vector<std::pair<const nodeSequence<TypeValue>*, bool>> stack;
+        const nodeSequence<TypeValue>* p = root;
+        bool flip = false;
+        while (p || !stack.empty())
+        {
+            while (p)
+            {
+                flip = flip != p->reversed;
+                stack.push_back(std::make_pair(p, flip));
+                p = flip ? p->right : p->left;
+            }
+            p = stack.back().first;
+            flip = stack.back().second;
+            stack.pop_back();
+            func(p->value);
+            p = flip ? p->left : p->right;
+        }
+    }
+
+    void clear()
+    {
+        clearElement(root);
+        root = 0;
+    }
+};
@@ -1,28 +1,83 @@
 #pragma once
-#include<vector>
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <vector>
+#include "NodePool.h"
+#include "TreeBatch.h"
+#include "ForkJoin.h"
+#include "TreeStats.h"
+#include "TreeIterator.h"
+#include "OrderStatistics.h"
+#include "KeyCompare.h"
+#include "TreapPriority.h"
+#include "TreeImage.h"
 
-template <typename TypeKey, typename TypePriority, typename TypeData>
-struct nodeTreap
+template <typename TypeKey, typename TypePriority, typename TypeData, typename TypeOrder = noOrderStatistics, typename TypeCompare = keyCompare>
+struct nodeTreap : TypeOrder::nodeAugment, TypeCompare::nodeCache
 {
     TypeKey key;
     TypePriority priority;
     TypeData data;
 
-    nodeTreap<TypeKey, TypePriority, TypeData>* left;
-    nodeTreap<TypeKey, TypePriority, TypeData>* right;
+    nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* left;
+    nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* right;
 
-    nodeTreap(const TypeKey& key_, const TypePriority& priority_, const TypeData& data_,
-        nodeTreap<TypeKey, TypePriority, TypeData>* left_ = 0,
-        nodeTreap<TypeKey, TypePriority, TypeData>* right_ = 0) :
-        key(key_), priority(priority_), data(data_), left(left_), right(right_) {}
+    template <typename TypeK, typename... Args>
+    nodeTreap(TypeK&& key_, const TypePriority& priority_, Args&&... data_) :
+        key(std::forward<TypeK>(key_)), priority(priority_), data(std::forward<Args>(data_)...), left(0), right(0)
+    {
+        this->cacheKey(key);
+        TypeOrder::update(this);
+    }
 };
 
-template <typename TypeKey, typename TypePriority, typename TypeData>
+template <typename TypeKey, typename TypePriority, typename TypeData, typename TypeAlloc = std::allocator<std::pair<const TypeKey, TypeData>>, typename TypeStats = noTreeStats, typename TypeOrder = noOrderStatistics, typename TypeCompare = keyCompare, typename TypePriorityGen = randomPriority>
 class TreapTree
 {
-    nodeTreap<TypeKey, TypePriority, TypeData>* root;
+    typedef typename std::allocator_traits<TypeAlloc>::template rebind_alloc<nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>> TypeNodeAlloc;
+    typedef std::allocator_traits<TypeNodeAlloc> TypeNodeTraits;
+
+    TypeNodeAlloc alloc;
+    nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* root;
+    size_t numnodeTreap;
+    bool iterative;
+    TypeStats stats;
+    TypeCompare compare;
+    TypePriorityGen generator;
+
+    static const size_t pathCapacity = 64;
+
+    typedef typename compareProbe<TypeCompare, TypeKey, TypeKey>::type TypeKeyProbe;
+
+    typedef updatePath<TypeOrder::enabled, TypeOrder, nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>, pathCapacity> TypeUpdatePath;
+
+    template <typename TypeK, typename... Args>
+    nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* createNode(TypeK&& key, const TypePriority& priority, Args&&... data)
+    {
+        nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* p = TypeNodeTraits::allocate(alloc, 1);
+        try
+        {
+            TypeNodeTraits::construct(alloc, p, std::forward<TypeK>(key), priority, std::forward<Args>(data)...);
+        }
+        catch (...)
+        {
+            TypeNodeTraits::deallocate(alloc, p, 1);
+            throw;
+        }
+        numnodeTreap++;
+        return p;
+    }
 
-    void merge(nodeTreap<TypeKey, TypePriority, TypeData>*& temp, nodeTreap<TypeKey, TypePriority, TypeData>* left, nodeTreap<TypeKey, TypePriority, TypeData>* right)
+    void destroyNode(nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* p)
+    {
+        TypeNodeTraits::destroy(alloc, p);
+        TypeNodeTraits::deallocate(alloc, p, 1);
+        numnodeTreap--;
+    }
+
+    void merge(nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>*& temp, nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* left, nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* right)
     {
         if (!left)
         {
@@ -34,74 +89,95 @@ class TreapTree
         }
         else if (left->priority < right->priority)
         {
+            stats.restructure();
+            TypeOrder::push(left);
             merge(left->right, left->right, right);
+            TypeOrder::update(left);
             temp = left;
         }
         else
         {
+            stats.restructure();
+            TypeOrder::push(right);
             merge(right->left, left, right->left);
+            TypeOrder::update(right);
             temp = right;
         }
     }
 
-    void split(nodeTreap<TypeKey, TypePriority, TypeData>* temp,
-            const TypeKey &key,
-            nodeTreap<TypeKey, TypePriority, TypeData>*& left,
-            nodeTreap<TypeKey, TypePriority, TypeData>*& right)
+    void split(nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* temp,
+            const TypeKeyProbe &key,
+            nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>*& left,
+            nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>*& right)
     {
         if (!temp)
         {
             left = 0;
             right = 0;
+            return;
         }
-        else if (temp->key > key)
+        TypeOrder::push(temp);
+        if (compare(key, temp) < 0)
         {
+            stats.restructure();
             split(temp->left, key, left, temp->left);
+            TypeOrder::update(temp);
             right = temp;
         }
         else
         {
+            stats.restructure();
             split(temp->right, key, temp->right, right);
+            TypeOrder::update(temp);
             left = temp;
         }
     }
 
-    void insertElement(nodeTreap<TypeKey, TypePriority, TypeData>*& temp, nodeTreap<TypeKey, TypePriority, TypeData>* elem)
+    void insertElement(nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>*& temp, nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* elem, const TypeKeyProbe& key)
     {
         if (!temp)
         {
             temp = elem;
+            return;
         }
-        else if (elem->priority < temp->priority)
+        TypeOrder::push(temp);
+        if (elem->priority < temp->priority)
         {
-            split(temp, elem->key, elem->left, elem->right);
+            split(temp, key, elem->left, elem->right);
+            TypeOrder::update(elem);
             temp = elem;
         }
         else
         {
-            if (temp->key < elem->key)
+            stats.compare();
+            if (compare(key, temp) > 0)
             {
-                insertElement(temp->right, elem);
+                insertElement(temp->right, elem, key);
             }
             else
             { 
-                insertElement(temp->left, elem);
+                insertElement(temp->left, elem, key);
             }
+            TypeOrder::update(temp);
         }
     }
 
-    void removeElement(nodeTreap<TypeKey, TypePriority, TypeData>*& temp, const TypeKey& key)
+    template <typename TypeProbe>
+    void removeElement(nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>*& temp, const TypeProbe& key)
     {
         if (!temp) return;
-        if (temp->key == key)
+        stats.compare();
+        TypeOrder::push(temp);
+        int c = compare(key, temp);
+        if (c == 0)
         {
-            nodeTreap<TypeKey, TypePriority, TypeData>* tmp = temp;
+            nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* tmp = temp;
             merge(temp, temp->left, temp->right);
-            delete tmp;
+            destroyNode(tmp);
         }
         else
         {
-            if (temp->key < key)
+            if (c > 0)
             {
                 removeElement(temp->right, key);
             }
@@ -109,17 +185,22 @@ class TreapTree
             {
                 removeElement(temp->left, key);
             }
+            TypeOrder::update(temp);
         }
     }
 
-    nodeTreap<TypeKey, TypePriority, TypeData>* findElement(nodeTreap<TypeKey, TypePriority, TypeData>* temp, const TypeKey& key)
+    template <typename TypeProbe>
+    nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* findElement(nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* temp, const TypeProbe& key)
     {
         if (!temp) return 0;
-        if (temp->key == key)
+        stats.compare();
+        TypeOrder::push(temp);
+        int c = compare(key, temp);
+        if (c == 0)
         {
             return temp;
         }
-        else if (temp->key < key)
+        else if (c > 0)
         { 
             return findElement(temp->right, key);
         }
@@ -130,38 +211,797 @@ class TreapTree
         
     }
 
-    void clearElement(nodeTreap<TypeKey, TypePriority, TypeData>* p)
+    void mergeIterative(nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>*& temp, nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* left, nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* right)
+    {
+        nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>** link = &temp;
+        TypeUpdatePath touched;
+        while (left && right)
+        {
+            stats.restructure();
+            if (left->priority < right->priority)
+            {
+                TypeOrder::push(left);
+                *link = left;
+                touched.push(left);
+                link = &left->right;
+                left = left->right;
+            }
+            else
+            {
+                TypeOrder::push(right);
+                *link = right;
+                touched.push(right);
+                link = &right->left;
+                right = right->left;
+            }
+        }
+        *link = left ? left : right;
+        touched.refresh();
+    }
+
+    void splitIterative(nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* temp,
+            const TypeKeyProbe& key,
+            nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>*& left,
+            nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>*& right)
+    {
+        nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>** linkLeft = &left;
+        nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>** linkRight = &right;
+        TypeUpdatePath touched;
+        while (temp)
+        {
+            stats.restructure();
+            TypeOrder::push(temp);
+            touched.push(temp);
+            if (compare(key, temp) < 0)
+            {
+                *linkRight = temp;
+                linkRight = &temp->left;
+                temp = temp->left;
+            }
+            else
+            {
+                *linkLeft = temp;
+                linkLeft = &temp->right;
+                temp = temp->right;
+            }
+        }
+        *linkLeft = 0;
+        *linkRight = 0;
+        touched.refresh();
+    }
+
+    void insertIterative(nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* elem, const TypeKeyProbe& key)
+    {
+        nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>** link = &root;
+        TypeUpdatePath ancestors;
+        while (*link && !(elem->priority < (*link)->priority))
+        {
+            stats.compare();
+            TypeOrder::push(*link);
+            ancestors.push(*link);
+            link = compare(key, *link) > 0 ? &(*link)->right : &(*link)->left;
+        }
+        splitIterative(*link, key, elem->left, elem->right);
+        TypeOrder::update(elem);
+        *link = elem;
+        ancestors.refresh();
+    }
+
+    template <typename TypeProbe>
+    void removeIterative(const TypeProbe& key)
+    {
+        nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>** link = &root;
+        TypeUpdatePath ancestors;
+        int c;
+        while (*link && (c = compare(key, *link)) != 0)
+        {
+            stats.compare();
+            TypeOrder::push(*link);
+            ancestors.push(*link);
+            link = c > 0 ? &(*link)->right : &(*link)->left;
+        }
+        if (!*link) return;
+        stats.compare();
+        nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* tmp = *link;
+        TypeOrder::push(tmp);
+        mergeIterative(*link, tmp->left, tmp->right);
+        destroyNode(tmp);
+        ancestors.refresh();
+    }
+
+    template <typename TypeProbe>
+    nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* findIterative(const TypeProbe& key)
+    {
+        nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* temp = root;
+        int c;
+        while (temp && (c = compare(key, temp)) != 0)
+        {
+            stats.compare();
+            TypeOrder::push(temp);
+            temp = c > 0 ? temp->right : temp->left;
+        }
+        if (temp) stats.compare();
+        return temp;
+    }
+
+    template <typename Iterator, typename IteratorPriority>
+    nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* buildElement(Iterator first, Iterator last, IteratorPriority firstPriority)
+    {
+        std::vector<nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>*> spine;
+        for (; first != last; ++first, ++firstPriority)
+        {
+            nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* elem = createNode(first->first, *firstPriority, first->second);
+            nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* child = 0;
+            while (!spine.empty() && elem->priority < spine.back()->priority)
+            {
+                child = spine.back();
+                TypeOrder::update(child);
+                spine.pop_back();
+            }
+            elem->left = child;
+            if (!spine.empty())
+                spine.back()->right = elem;
+            spine.push_back(elem);
+        }
+        for (size_t i = spine.size(); TypeOrder::enabled && i-- > 0; )
+            TypeOrder::update(spine[i]);
+        return spine.empty() ? 0 : spine.front();
+    }
+
+    void mergeTree(nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>*& temp, nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* left, nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* right)
+    {
+        if (iterative)
+            mergeIterative(temp, left, right);
+        else
+            merge(temp, left, right);
+    }
+
+    void splitTree(nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* temp,
+            const TypeKeyProbe& key,
+            nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>*& left,
+            nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>*& equal,
+            nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>*& right)
+    {
+        if (iterative)
+            splitIterative(temp, key, left, right);
+        else
+            split(temp, key, left, right);
+        equal = 0;
+        if (!left) return;
+        nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>** link = &left;
+        TypeUpdatePath spine;
+        while ((*link)->right)
+        {
+            TypeOrder::push(*link);
+            spine.push(*link);
+            link = &(*link)->right;
+        }
+        if (compare(key, *link) <= 0)
+        {
+            equal = *link;
+            TypeOrder::push(equal);
+            *link = equal->left;
+            equal->left = 0;
+            TypeOrder::update(equal);
+            spine.refresh();
+        }
+    }
+
+    void collectElement(nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* p, std::vector<nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>*>& dropped)
     {
         if (!p) return;
-        nodeTreap<TypeKey, TypePriority, TypeData>* q = p->left;
-        nodeTreap<TypeKey, TypePriority, TypeData>* r = p->right;
-        delete p;
-        if (!q) clearElement(q);
-        if (!r) clearElement(r);
+        size_t i = dropped.size();
+        dropped.push_back(p);
+        for (; i < dropped.size(); ++i)
+        {
+            if (dropped[i]->left) dropped.push_back(dropped[i]->left);
+            if (dropped[i]->right) dropped.push_back(dropped[i]->right);
+        }
+    }
+
+    nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* uniteElement(nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* temp, nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* other,
+        std::vector<nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>*>& dropped, size_t size, int forks)
+    {
+        if (!temp) return other;
+        if (!other) return temp;
+        TypeOrder::push(temp);
+        TypeOrder::push(other);
+        nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* left;
+        nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* equal;
+        nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* right;
+        std::vector<nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>*> droppedLeft;
+        bool parallel = forks > 0 && size >= forkCutoff;
+        if (other->priority < temp->priority)
+        {
+            splitTree(temp, TypeKeyProbe(other->key), left, equal, right);
+            if (equal)
+            {
+                std::swap(other->data, equal->data);
+                dropped.push_back(equal);
+            }
+            forkJoin(parallel,
+                [&] { other->left = uniteElement(left, other->left, parallel ? droppedLeft : dropped, size / 2, forks - 1); },
+                [&] { other->right = uniteElement(right, other->right, dropped, size / 2, forks - 1); });
+            dropped.insert(dropped.end(), droppedLeft.begin(), droppedLeft.end());
+            TypeOrder::update(other);
+            return other;
+        }
+        splitTree(other, TypeKeyProbe(temp->key), left, equal, right);
+        if (equal) dropped.push_back(equal);
+        forkJoin(parallel,
+            [&] { temp->left = uniteElement(temp->left, left, parallel ? droppedLeft : dropped, size / 2, forks - 1); },
+            [&] { temp->right = uniteElement(temp->right, right, dropped, size / 2, forks - 1); });
+        dropped.insert(dropped.end(), droppedLeft.begin(), droppedLeft.end());
+        TypeOrder::update(temp);
+        return temp;
+    }
+
+    nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* intersectElement(nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* temp, nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* other,
+        std::vector<nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>*>& dropped, size_t size, int forks)
+    {
+        if (!temp || !other)
+        {
+            collectElement(temp, dropped);
+            collectElement(other, dropped);
+            return 0;
+        }
+        TypeOrder::push(temp);
+        TypeOrder::push(other);
+        nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* left;
+        nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* equal;
+        nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* right;
+        nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* top = temp;
+        std::vector<nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>*> droppedLeft;
+        bool parallel = forks > 0 && size >= forkCutoff;
+        if (other->priority < temp->priority)
+        {
+            top = other;
+            splitTree(temp, TypeKeyProbe(other->key), left, equal, right);
+            if (equal) std::swap(other->data, equal->data);
+            forkJoin(parallel,
+                [&] { left = intersectElement(left, other->left, parallel ? droppedLeft : dropped, size / 2, forks - 1); },
+                [&] { right = intersectElement(right, other->right, dropped, size / 2, forks - 1); });
+        }
+        else
+        {
+            splitTree(other, TypeKeyProbe(temp->key), left, equal, right);
+            forkJoin(parallel,
+                [&] { left = intersectElement(temp->left, left, parallel ? droppedLeft : dropped, size / 2, forks - 1); },
+                [&] { right = intersectElement(temp->right, right, dropped, size / 2, forks - 1); });
+        }
+        dropped.insert(dropped.end(), droppedLeft.begin(), droppedLeft.end());
+        if (equal)
+        {
+            dropped.push_back(equal);
+            top->left = left;
+            top->right = right;
+            TypeOrder::update(top);
+            return top;
+        }
+        dropped.push_back(top);
+        nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* result;
+        mergeTree(result, left, right);
+        return result;
+    }
+
+    nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* differenceElement(nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* temp, nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* other,
+        std::vector<nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>*>& dropped, size_t size, int forks)
+    {
+        if (!temp)
+        {
+            collectElement(other, dropped);
+            return 0;
+        }
+        if (!other) return temp;
+        TypeOrder::push(temp);
+        TypeOrder::push(other);
+        nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* left;
+        nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* equal;
+        nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* right;
+        splitTree(other, TypeKeyProbe(temp->key), left, equal, right);
+        std::vector<nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>*> droppedLeft;
+        bool parallel = forks > 0 && size >= forkCutoff;
+        forkJoin(parallel,
+            [&] { temp->left = differenceElement(temp->left, left, parallel ? droppedLeft : dropped, size / 2, forks - 1); },
+            [&] { temp->right = differenceElement(temp->right, right, dropped, size / 2, forks - 1); });
+        dropped.insert(dropped.end(), droppedLeft.begin(), droppedLeft.end());
+        TypeOrder::update(temp);
+        if (!equal) return temp;
+        dropped.push_back(equal);
+        dropped.push_back(temp);
+        nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* result;
+        mergeTree(result, temp->left, temp->right);
+        return result;
+    }
+
+    nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* copyElement(nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* p)
+    {
+        if (!p) return 0;
+        TypeOrder::push(p);
+        nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* q = createNode(p->key, p->priority, p->data);
+        q->left = copyElement(p->left);
+        q->right = copyElement(p->right);
+        TypeOrder::update(q);
+        return q;
+    }
+
+    nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* takeElements(TreapTree& other)
+    {
+        nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* q;
+        if (alloc == other.alloc)
+        {
+            q = other.root;
+            numnodeTreap += other.numnodeTreap;
+            other.root = 0;
+            other.numnodeTreap = 0;
+        }
+        else
+        {
+            q = copyElement(other.root);
+            other.clear();
+        }
+        return q;
+    }
+
+    static int forkBudget()
+    {
+        return TypeStats::enabled ? 0 : forkDepth();
+    }
+
+    template <typename Operation>
+    void setOperation(nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* temp, nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* other, Operation operation, int forks)
+    {
+        std::vector<nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>*> dropped;
+        root = (this->*operation)(temp, other, dropped, numnodeTreap, forks);
+        for (size_t i = 0; i < dropped.size(); ++i)
+            destroyNode(dropped[i]);
+    }
+
+    template <typename Iterator>
+    void removeBatch(nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>*& temp, Iterator first, Iterator last)
+    {
+        if (first == last || !temp) return;
+        TypeOrder::push(temp);
+        Iterator mid = std::lower_bound(first, last, temp->key,
+            [this](const TypeKey& a, const TypeKey& k) { return compare(a, k) < 0; });
+        bool hit = mid != last && compare(temp->key, *mid) >= 0;
+        removeBatch(temp->left, first, mid);
+        removeBatch(temp->right, hit ? mid + 1 : mid, last);
+        if (hit)
+        {
+            nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* tmp = temp;
+            mergeTree(temp, temp->left, temp->right);
+            destroyNode(tmp);
+        }
+        else
+            TypeOrder::update(temp);
+    }
+
+    template <typename Iterator>
+    void findBatch(nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* temp, Iterator first, Iterator last,
+        const std::vector<TypeKey>& keys, std::vector<TypeData>& result)
+    {
+        if (first == last || !temp) return;
+        TypeOrder::push(temp);
+        Iterator mid = std::lower_bound(first, last, temp->key,
+            [this, &keys](size_t i, const TypeKey& k) { return compare(keys[i], k) < 0; });
+        Iterator midEnd = mid;
+        while (midEnd != last && compare(temp->key, keys[*midEnd]) >= 0)
+        {
+            result[*midEnd] = temp->data;
+            ++midEnd;
+        }
+        findBatch(temp->left, first, mid, keys, result);
+        findBatch(temp->right, midEnd, last, keys, result);
+    }
+
+    template <typename Iterator>
+    std::vector<TypePriority> generatePriorities(Iterator first, Iterator last)
+    {
+        std::vector<TypePriority> priorities;
+        priorities.reserve(std::distance(first, last));
+        for (; first != last; ++first)
+            priorities.push_back(generator.template next<TypePriority>(first->first));
+        return priorities;
+    }
+
+    void clearElement(nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* p)
+    {
+        std::vector<nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>*> stack;
+        if (p) stack.push_back(p);
+        while (!stack.empty())
+        {
+            p = stack.back();
+            stack.pop_back();
+            if (p->left) stack.push_back(p->left);
+            if (p->right) stack.push_back(p->right);
+            destroyNode(p);
+        }
     }
 public:
-    TreapTree() : root(0) {}
+    explicit TreapTree(const TypeAlloc& alloc_ = TypeAlloc(), const TypeCompare& compare_ = TypeCompare(), const TypePriorityGen& generator_ = TypePriorityGen()) :
+        alloc(alloc_), root(0), numnodeTreap(0), iterative(true), compare(compare_), generator(generator_) {}
     ~TreapTree() { clear(); }
     void insert(const TypeKey& key, const TypePriority& priority, const TypeData& value)
     {
-        nodeTreap<TypeKey, TypePriority, TypeData>* elem = new nodeTreap<TypeKey, TypePriority, TypeData>(key, priority, value);
-        insertElement(root, elem);
+        emplace(key, priority, value);
+    }
+
+    void insert(const std::pair<TypeKey, TypeData>& value)
+    {
+        emplace(value.first, generator.template next<TypePriority>(value.first), value.second);
     }
 
-    void erase(const TypeKey& key)
+    void insert(std::pair<TypeKey, TypeData>&& value)
     {
-        removeElement(root, key);
+        TypePriority priority = generator.template next<TypePriority>(value.first);
+        emplace(std::move(value.first), priority, std::move(value.second));
     }
 
-    TypeData find(const TypeKey& key)
+    template <typename TypeK, typename... Args>
+    void emplace(TypeK&& key, const TypePriority& priority, Args&&... data)
     {
-        auto element = findElement(root, key);
-        return element->data;
+        stats.begin(treeInsert);
+        nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* elem = createNode(std::forward<TypeK>(key), priority, std::forward<Args>(data)...);
+        TypeKeyProbe q(elem->key);
+        if (iterative)
+            insertIterative(elem, q);
+        else
+            insertElement(root, elem, q);
+    }
+
+    template <typename TypeK, typename... Args>
+    bool try_emplace(TypeK&& key, const TypePriority& priority, Args&&... data)
+    {
+        stats.begin(treeInsert);
+        typename compareProbe<TypeCompare, TypeKey, TypeK>::type lookup(key);
+        if (iterative ? findIterative(lookup) : findElement(root, lookup))
+            return false;
+        nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* elem = createNode(std::forward<TypeK>(key), priority, std::forward<Args>(data)...);
+        TypeKeyProbe q(elem->key);
+        if (iterative)
+            insertIterative(elem, q);
+        else
+            insertElement(root, elem, q);
+        return true;
+    }
+
+    typedef pathIterator<nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>, TypeKey, TypeData, pathCapacity,
+        typename TypeOrder::template pathCarry<nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>, TypeKey, TypeData, pathCapacity>> iterator;
+    typedef pathIterator<nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>, TypeKey, const TypeData, pathCapacity,
+        typename TypeOrder::template pathCarry<nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>, TypeKey, const TypeData, pathCapacity>> const_iterator;
+
+    iterator begin()
+    {
+        return iterator::first(&root);
+    }
+
+    iterator end()
+    {
+        return iterator(&root);
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator::first(&root);
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator(&root);
+    }
+
+    template <typename TypeLookup>
+    iterator lower_bound(const TypeLookup& key)
+    {
+        typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type q(key);
+        return iterator::bound(&root, [this, &q](const nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* p) { return compare(q, p) > 0; });
+    }
+
+    template <typename TypeLookup>
+    iterator upper_bound(const TypeLookup& key)
+    {
+        typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type q(key);
+        return iterator::bound(&root, [this, &q](const nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* p) { return compare(q, p) >= 0; });
+    }
+
+    template <typename TypeLookup>
+    const_iterator lower_bound(const TypeLookup& key) const
+    {
+        typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type q(key);
+        return const_iterator::bound(&root, [this, &q](const nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* p) { return compare(q, p) > 0; });
+    }
+
+    template <typename TypeLookup>
+    const_iterator upper_bound(const TypeLookup& key) const
+    {
+        typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type q(key);
+        return const_iterator::bound(&root, [this, &q](const nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* p) { return compare(q, p) >= 0; });
+    }
+
+    template <typename TypeLookup>
+    std::pair<iterator, iterator> equal_range(const TypeLookup& key)
+    {
+        return std::make_pair(lower_bound(key), upper_bound(key));
+    }
+
+    template <typename TypeLookup>
+    std::pair<const_iterator, const_iterator> equal_range(const TypeLookup& key) const
+    {
+        return std::make_pair(lower_bound(key), upper_bound(key));
+    }
+
+    template <typename TypeLookup>
+    size_t rank(const TypeLookup& key) const
+    {
+        static_assert(TypeOrder::enabled, "rank needs orderStatistics");
+        typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type q(key);
+        return rankElement<TypeOrder>(root, compare, q);
+    }
+
+    iterator select(size_t k)
+    {
+        static_assert(TypeOrder::enabled, "select needs orderStatistics");
+        return selectElement<TypeOrder, iterator>(&root, k);
+    }
+
+    const_iterator select(size_t k) const
+    {
+        static_assert(TypeOrder::enabled, "select needs orderStatistics");
+        return selectElement<TypeOrder, const_iterator>(&root, k);
+    }
+
+    template <typename TypeLookup>
+    size_t count_range(const TypeLookup& lo, const TypeLookup& hi) const
+    {
+        size_t first = rank(lo);
+        size_t last = rank(hi);
+        return last > first ? last - first : 0;
+    }
+
+    template <typename TypeLookup, typename Func>
+    void for_each_in_range(const TypeLookup& lo, const TypeLookup& hi, Func func) const
+    {
+        for (const_iterator it = lower_bound(lo), last = end(); it != last; ++it)
+        {
+            typename const_iterator::reference value = *it;
+            if (compare(value.first, hi) >= 0) break;
+            func(value.first, value.second);
+        }
+    }
+
+    template <typename TypeLookup, typename TypeAggregate = TypeOrder>
+    typename TypeAggregate::value_type aggregate(const TypeLookup& lo, const TypeLookup& hi) const
+    {
+        typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type qlo(lo);
+        typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type qhi(hi);
+        return aggregateElement<TypeAggregate>(root, compare, qlo, qhi);
+    }
+
+    template <typename TypeLookup, typename Func>
+    bool update(const TypeLookup& key, Func func)
+    {
+        stats.begin(treeFind);
+        typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type q(key);
+        TypeUpdatePath ancestors;
+        nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* p = root;
+        int c;
+        while (p && (c = compare(q, p)) != 0)
+        {
+            stats.compare();
+            TypeOrder::push(p);
+            ancestors.push(p);
+            p = c > 0 ? p->right : p->left;
+        }
+        if (!p) return false;
+        stats.compare();
+        TypeOrder::push(p);
+        func(p->data);
+        TypeOrder::update(p);
+        ancestors.refresh();
+        return true;
+    }
+
+    template <typename TypeLookup, typename TypeAggregate = TypeOrder>
+    void update_range(const TypeLookup& lo, const TypeLookup& hi, const typename TypeAggregate::value_type& delta)
+    {
+        static_assert(TypeAggregate::lazy, "update_range needs lazySubtreeAggregate");
+        typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type qlo(lo);
+        typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type qhi(hi);
+        updateRangeElement<TypeAggregate>(root, compare, qlo, qhi, delta);
+    }
+
+    template <typename Iterator, typename IteratorPriority>
+    void build(Iterator first, Iterator last, IteratorPriority firstPriority)
+    {
+        clear();
+        stats.begin(treeBulk);
+        root = buildElement(first, last, firstPriority);
+    }
+
+    template <typename Iterator>
+    void build(Iterator first, Iterator last)
+    {
+        std::vector<TypePriority> priorities = generatePriorities(first, last);
+        build(first, last, priorities.begin());
+    }
+
+    void build(const std::vector<std::pair<TypeKey, TypeData>>& elements)
+    {
+        build(elements, generatePriorities(elements.begin(), elements.end()));
+    }
+
+    void build(const std::vector<std::pair<TypeKey, TypeData>>& elements, const std::vector<TypePriority>& priorities)
+    {
+        std::vector<size_t> order(elements.size());
+        for (size_t i = 0; i < order.size(); ++i)
+            order[i] = i;
+        std::stable_sort(order.begin(), order.end(),
+            [this, &elements](size_t a, size_t b) { return compare(elements[a].first, elements[b].first) < 0; });
+        std::vector<std::pair<TypeKey, TypeData>> sortedElements;
+        std::vector<TypePriority> sortedPriorities;
+        sortedElements.reserve(order.size());
+        sortedPriorities.reserve(order.size());
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            sortedElements.push_back(elements[order[i]]);
+            sortedPriorities.push_back(priorities[order[i]]);
+        }
+        build(sortedElements.begin(), sortedElements.end(), sortedPriorities.begin());
+    }
+
+    bool save(const std::string& path) const
+    {
+        treeImageWriter<TypeKey, TypeData, TypePriority> image(numnodeTreap);
+        for (const_iterator it = begin(), last = end(); it != last; ++it)
+        {
+            typename const_iterator::reference value = *it;
+            image.add(value.first, value.second, it.get()->priority);
+        }
+        return image.write(path);
+    }
+
+    bool load(const std::string& path)
+    {
+        treeImageView<TypeKey, TypeData, TypeCompare> image(compare);
+        if (!image.open(path)) return false;
+        if (image.priority_width() == 0)
+        {
+            build(image.begin(), image.end());
+            return true;
+        }
+        if (image.priority_width() != sizeof(TypePriority)) return false;
+        std::vector<TypePriority> priorities(image.size());
+        for (size_t i = 0; i < priorities.size(); ++i)
+            priorities[i] = image.template priority<TypePriority>(i);
+        build(image.begin(), image.end(), priorities.begin());
+        return true;
+    }
+
+    void insert_batch(std::vector<std::pair<TypeKey, TypeData>> batch, std::vector<TypePriority> priorities)
+    {
+        stats.begin(treeBulk);
+        prepareBatch(batch, priorities, compare);
+        setOperation(buildElement(batch.begin(), batch.end(), priorities.begin()), root, &TreapTree::uniteElement, 0);
+    }
+
+    void insert_batch(std::vector<std::pair<TypeKey, TypeData>> batch)
+    {
+        std::vector<TypePriority> priorities = generatePriorities(batch.begin(), batch.end());
+        insert_batch(std::move(batch), std::move(priorities));
+    }
+
+    void erase_batch(std::vector<TypeKey> keys)
+    {
+        stats.begin(treeBulk);
+        prepareBatch(keys, compare);
+        removeBatch(root, keys.begin(), keys.end());
+    }
+
+    std::vector<TypeData> find_batch(const std::vector<TypeKey>& keys)
+    {
+        stats.begin(treeBulk);
+        std::vector<TypeData> result(keys.size());
+        std::vector<size_t> order = orderBatch(keys, compare);
+        findBatch(root, order.begin(), order.end(), keys, result);
+        return result;
+    }
+
+    void unite(TreapTree& other)
+    {
+        if (&other == this) return;
+        stats.begin(treeBulk);
+        nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* q = takeElements(other);
+        setOperation(root, q, &TreapTree::uniteElement, forkBudget());
+    }
+
+    void intersect(TreapTree& other)
+    {
+        if (&other == this) return;
+        stats.begin(treeBulk);
+        nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* q = takeElements(other);
+        setOperation(root, q, &TreapTree::intersectElement, forkBudget());
+    }
+
+    void difference(TreapTree& other)
+    {
+        if (&other == this) return;
+        stats.begin(treeBulk);
+        nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>* q = takeElements(other);
+        setOperation(root, q, &TreapTree::differenceElement, forkBudget());
+    }
+
+    size_t getNumnodeTreap() const
+    {
+        return numnodeTreap;
+    }
+
+    const TypeStats& getStats() const
+    {
+        return stats;
+    }
+
+    treeShape getShape() const
+    {
+        return measureShape(root);
+    }
+
+    template <typename TypeLookup>
+    void erase(const TypeLookup& key)
+    {
+        stats.begin(treeErase);
+        typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type q(key);
+        if (iterative)
+            removeIterative(q);
+        else
+            removeElement(root, q);
+    }
+
+    template <typename TypeLookup>
+    TypeData find(const TypeLookup& key)
+    {
+        stats.begin(treeFind);
+        typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type q(key);
+        auto element = iterative ? findIterative(q) : findElement(root, q);
+        return element ? element->data : TypeData();
+    }
+
+    template <typename TypeLookup>
+    bool contains(const TypeLookup& key)
+    {
+        stats.begin(treeFind);
+        typename compareProbe<TypeCompare, TypeKey, TypeLookup>::type q(key);
+        return (iterative ? findIterative(q) : findElement(root, q)) != 0;
+    }
+
+    void setIterative(bool value)
+    {
+        iterative = value;
+    }
+
+    bool isIterative() const
+    {
+        return iterative;
+    }
+
+    template <typename Func>
+    void for_each(Func func) const
+    {
+        for (const_iterator it = begin(), last = end(); it != last; ++it)
+        {
+            typename const_iterator::reference value = *it;
+            func(value.first, value.second);
+        }
     }
 
     void clear()
     {
-        clearElement(root);
+        bool bulk = allocatorRelease<TypeNodeAlloc>::exclusive(alloc);
+        if (!bulk || !std::is_trivially_destructible<nodeTreap<TypeKey, TypePriority, TypeData, TypeOrder, TypeCompare>>::value)
+            clearElement(root);
+        if (bulk)
+            allocatorRelease<TypeNodeAlloc>::release(alloc);
         root = 0;
+        numnodeTreap = 0;
     }
 };
@@ -0,0 +1,69 @@
+#pragma once
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+template <typename TypeKey, typename TypeData, typename TypeCompare>
+void prepareBatch(std::vector<std::pair<TypeKey, TypeData>>& batch, const TypeCompare& compare)
+{
+    std::stable_sort(batch.begin(), batch.end(),
+        [&compare](const std::pair<TypeKey, TypeData>& a, const std::pair<TypeKey, TypeData>& b) { return compare(a.first, b.first) < 0; });
+    size_t n = 0;
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+        if (n > 0 && compare(batch[n - 1].first, batch[i].first) >= 0)
+            batch[n - 1] = std::move(batch[i]);
+        else if (n++ != i)
+            batch[n - 1] = std::move(batch[i]);
+    }
+    batch.erase(batch.begin() + n, batch.end());
+}
+
+template <typename TypeKey, typename TypeData, typename TypePriority, typename TypeCompare>
+void prepareBatch(std::vector<std::pair<TypeKey, TypeData>>& batch, std::vector<TypePriority>& priorities, const TypeCompare& compare)
+{
+    std::vector<size_t> order(batch.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(),
+        [&batch, &compare](size_t a, size_t b) { return compare(batch[a].first, batch[b].first) < 0; });
+    std::vector<std::pair<TypeKey, TypeData>> sortedBatch;
+    std::vector<TypePriority> sortedPriorities;
+    sortedBatch.reserve(order.size());
+    sortedPriorities.reserve(order.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        if (!sortedBatch.empty() && compare(sortedBatch.back().first, batch[order[i]].first) >= 0)
+        {
+            sortedBatch.back() = std::move(batch[order[i]]);
+            sortedPriorities.back() = priorities[order[i]];
+        }
+        else
+        {
+            sortedBatch.push_back(std::move(batch[order[i]]));
+            sortedPriorities.push_back(priorities[order[i]]);
+        }
+    }
+    batch.swap(sortedBatch);
+    priorities.swap(sortedPriorities);
+}
+
+template <typename TypeKey, typename TypeCompare>
+void prepareBatch(std::vector<TypeKey>& keys, const TypeCompare& compare)
+{
+    std::sort(keys.begin(), keys.end(),
+        [&compare](const TypeKey& a, const TypeKey& b) { return compare(a, b) < 0; });
+    keys.erase(std::unique(keys.begin(), keys.end(),
+        [&compare](const TypeKey& a, const TypeKey& b) { return compare(a, b) == 0; }), keys.end());
+}
+
+template <typename TypeKey, typename TypeCompare>
+std::vector<size_t> orderBatch(const std::vector<TypeKey>& keys, const TypeCompare& compare)
+{
+    std::vector<size_t> order(keys.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::sort(order.begin(), order.end(),
+        [&keys, &compare](size_t a, size_t b) { return compare(keys[a], keys[b]) < 0; });
+    return order;
+}
@@ -0,0 +1,422 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "KeyCompare.h"
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+template <typename TypeValue, typename = void>
+struct imageCodec;
+
+template <typename TypeValue>
+struct imageCodec<TypeValue, typename std::enable_if<std::is_trivially_copyable<TypeValue>::value>::type>
+{
+    typedef TypeValue TypeView;
+    static const uint32_t width = sizeof(TypeValue);
+
+    static void append(std::vector<char>& bytes, std::vector<uint64_t>&, const TypeValue& value)
+    {
+        const char* p = reinterpret_cast<const char*>(&value);
+        bytes.insert(bytes.end(), p, p + sizeof(TypeValue));
+    }
+
+    static TypeView get(const char* bytes, const uint64_t*, size_t i)
+    {
+        TypeValue value;
+        std::memcpy(&value, bytes + i * sizeof(TypeValue), sizeof(TypeValue));
+        return value;
+    }
+};
+
+template <>
+struct imageCodec<std::string>
+{
+    typedef std::string_view TypeView;
+    static const uint32_t width = 0;
+
+    static void append(std::vector<char>& bytes, std::vector<uint64_t>& offsets, const std::string& value)
+    {
+        bytes.insert(bytes.end(), value.begin(), value.end());
+        offsets.push_back(bytes.size());
+    }
+
+    static TypeView get(const char* bytes, const uint64_t* offsets, size_t i)
+    {
+        return TypeView(bytes + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+};
+
+template <typename TypeValue>
+struct imageWidth
+{
+    static const uint32_t value = sizeof(TypeValue);
+};
+
+template <>
+struct imageWidth<void>
+{
+    static const uint32_t value = 0;
+};
+
+struct treeImageHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t keyWidth;
+    uint32_t dataWidth;
+    uint32_t priorityWidth;
+    uint64_t count;
+    uint64_t keyBytes;
+    uint64_t dataBytes;
+};
+
+inline size_t imageAlign(size_t n)
+{
+    return (n + 7) & ~static_cast<size_t>(7);
+}
+
+inline treeImageHeader makeImageHeader(uint32_t keyWidth, uint32_t dataWidth, uint32_t priorityWidth, uint64_t count)
+{
+    treeImageHeader header;
+    std::memcpy(header.magic, "TREEIMG1", 8);
+    header.version = 1;
+    header.keyWidth = keyWidth;
+    header.dataWidth = dataWidth;
+    header.priorityWidth = priorityWidth;
+    header.count = count;
+    header.keyBytes = 0;
+    header.dataBytes = 0;
+    return header;
+}
+
+template <typename TypeKey, typename TypeData, typename TypePriority = void>
+class treeImageWriter
+{
+    typedef imageCodec<TypeKey> TypeKeyCodec;
+    typedef imageCodec<TypeData> TypeDataCodec;
+    static const uint32_t priorityWidth = imageWidth<TypePriority>::value;
+
+    std::vector<char> keys;
+    std::vector<char> data;
+    std::vector<char> priorities;
+    std::vector<uint64_t> keyOffsets;
+    std::vector<uint64_t> dataOffsets;
+    size_t count;
+
+    static void writeSection(std::ofstream& out, uint32_t width, const std::vector<uint64_t>& offsets, const std::vector<char>& bytes)
+    {
+        static const char padding[8] = {};
+        if (width == 0)
+            out.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+        out.write(bytes.data(), bytes.size());
+        out.write(padding, imageAlign(bytes.size()) - bytes.size());
+    }
+public:
+    explicit treeImageWriter(size_t n = 0) : keyOffsets(1, 0), dataOffsets(1, 0), count(0)
+    {
+        if (TypeKeyCodec::width)
+            keys.reserve(n * TypeKeyCodec::width);
+        if (TypeDataCodec::width)
+            data.reserve(n * TypeDataCodec::width);
+        priorities.reserve(n * priorityWidth);
+    }
+
+    void add(const TypeKey& key, const TypeData& value)
+    {
+        TypeKeyCodec::append(keys, keyOffsets, key);
+        TypeDataCodec::append(data, dataOffsets, value);
+        count++;
+    }
+
+    template <typename TypeP>
+    void add(const TypeKey& key, const TypeData& value, const TypeP& priority)
+    {
+        add(key, value);
+        const char* p = reinterpret_cast<const char*>(&priority);
+        priorities.insert(priorities.end(), p, p + sizeof(TypeP));
+    }
+
+    bool write(const std::string& path) const
+    {
+        std::ofstream out(path, std::ios::binary);
+        treeImageHeader header = makeImageHeader(TypeKeyCodec::width, TypeDataCodec::width, priorityWidth, count);
+        header.keyBytes = keys.size();
+        header.dataBytes = data.size();
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        writeSection(out, TypeKeyCodec::width, keyOffsets, keys);
+        writeSection(out, TypeDataCodec::width, dataOffsets, data);
+        out.write(priorities.data(), priorities.size());
+        return static_cast<bool>(out);
+    }
+};
+
+class mappedFile
+{
+    const char* bytes;
+    size_t length;
+#ifndef __linux__
+    std::vector<char> buffer;
+#endif
+public:
+    mappedFile() : bytes(0), length(0) {}
+    mappedFile(const mappedFile&) = delete;
+    mappedFile& operator=(const mappedFile&) = delete;
+    ~mappedFile() { close(); }
+
+    bool open(const std::string& path)
+    {
+        close();
+#ifdef __linux__
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        void* p = MAP_FAILED;
+        if (fstat(fd, &info) == 0 && info.st_size > 0)
+            p = mmap(0, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED)
+            return false;
+        bytes = static_cast<const char*>(p);
+        length = info.st_size;
+#else
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in.is_open())
+            return false;
+        buffer.resize(static_cast<size_t>(in.tellg()));
+        in.seekg(0);
+        if (!in.read(buffer.data(), buffer.size()))
+            return false;
+        bytes = buffer.data();
+        length = buffer.size();
+#endif
+        return true;
+    }
+
+    void close()
+    {
+#ifdef __linux__
+        if (bytes)
+            munmap(const_cast<char*>(bytes), length);
+#else
+        buffer.clear();
+#endif
+        bytes = 0;
+        length = 0;
+    }
+
+    const char* data() const
+    {
+        return bytes;
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+};
+
+template <typename TypeKey, typename TypeData, typename TypeCompare = keyCompare>
+class treeImageView
+{
+    typedef imageCodec<TypeKey> TypeKeyCodec;
+    typedef imageCodec<TypeData> TypeDataCodec;
+
+    mappedFile file;
+    TypeCompare compare;
+    size_t count;
+    uint32_t priorityWidth;
+    const char* keys;
+    const char* data;
+    const char* priorities;
+    const uint64_t* keyOffsets;
+    const uint64_t* dataOffsets;
+
+    static bool mapSection(const char*& cursor, const char* end, size_t n, uint32_t width, uint64_t bytes, const uint64_t*& offsets, const char*& section)
+    {
+        offsets = 0;
+        if (width == 0)
+        {
+            if (n >= static_cast<size_t>(end - cursor) / sizeof(uint64_t))
+                return false;
+            offsets = reinterpret_cast<const uint64_t*>(cursor);
+            cursor += (n + 1) * sizeof(uint64_t);
+            if (offsets[0] != 0 || offsets[n] != bytes)
+                return false;
+            for (size_t i = 0; i < n; ++i)
+            {
+                if (offsets[i] > offsets[i + 1])
+                    return false;
+            }
+        }
+        else if (bytes % width != 0 || bytes / width != n)
+            return false;
+        if (bytes > static_cast<uint64_t>(end - cursor) || static_cast<uint64_t>(end - cursor) < imageAlign(bytes))
+            return false;
+        section = cursor;
+        cursor += imageAlign(bytes);
+        return true;
+    }
+public:
+    class iterator
+    {
+        const treeImageView* view;
+        size_t index;
+        std::pair<typename TypeKeyCodec::TypeView, typename TypeDataCodec::TypeView> element;
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::pair<typename TypeKeyCodec::TypeView, typename TypeDataCodec::TypeView> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const value_type* pointer;
+        typedef const value_type& reference;
+
+        iterator(const treeImageView* view_, size_t index_) : view(view_), index(index_) {}
+
+        reference operator*()
+        {
+            element.first = view->key(index);
+            element.second = view->value(index);
+            return element;
+        }
+
+        pointer operator->()
+        {
+            return &**this;
+        }
+
+        iterator& operator++()
+        {
+            ++index;
+            return *this;
+        }
+
+        bool operator==(const iterator& other) const
+        {
+            return index == other.index;
+        }
+
+        bool operator!=(const iterator& other) const
+        {
+            return index != other.index;
+        }
+    };
+
+    explicit treeImageView(const TypeCompare& compare_ = TypeCompare()) : compare(compare_), count(0), priorityWidth(0), keys(0), data(0), priorities(0), keyOffsets(0), dataOffsets(0) {}
+
+    bool open(const std::string& path)
+    {
+        count = 0;
+        if (!file.open(path) || file.size() < sizeof(treeImageHeader))
+            return false;
+        treeImageHeader header;
+        std::memcpy(&header, file.data(), sizeof(header));
+        treeImageHeader expected = makeImageHeader(TypeKeyCodec::width, TypeDataCodec::width, header.priorityWidth, header.count);
+        if (std::memcmp(header.magic, expected.magic, 8) != 0 || header.version != expected.version ||
+            header.keyWidth != expected.keyWidth || header.dataWidth != expected.dataWidth)
+            return false;
+        if (header.count > file.size() - sizeof(header))
+            return false;
+        const char* cursor = file.data() + sizeof(header);
+        const char* end = file.data() + file.size();
+        size_t n = static_cast<size_t>(header.count);
+        if (!mapSection(cursor, end, n, TypeKeyCodec::width, header.keyBytes, keyOffsets, keys) ||
+            !mapSection(cursor, end, n, TypeDataCodec::width, header.dataBytes, dataOffsets, data) ||
+            (header.priorityWidth != 0 && n > static_cast<size_t>(end - cursor) / header.priorityWidth))
+            return false;
+        priorities = cursor;
+        priorityWidth = header.priorityWidth;
+        count = n;
+        return true;
+    }
+
+    void close()
+    {
+        file.close();
+        count = 0;
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    iterator begin() const
+    {
+        return iterator(this, 0);
+    }
+
+    iterator end() const
+    {
+        return iterator(this, count);
+    }
+
+    typename TypeKeyCodec::TypeView key(size_t i) const
+    {
+        return TypeKeyCodec::get(keys, keyOffsets, i);
+    }
+
+    typename TypeDataCodec::TypeView value(size_t i) const
+    {
+        return TypeDataCodec::get(data, dataOffsets, i);
+    }
+
+    uint32_t priority_width() const
+    {
+        return priorityWidth;
+    }
+
+    template <typename TypeP>
+    TypeP priority(size_t i) const
+    {
+        TypeP p;
+        std::memcpy(&p, priorities + i * sizeof(TypeP), sizeof(TypeP));
+        return p;
+    }
+
+    template <typename TypeLookup>
+    size_t lower_bound(const TypeLookup& lookup) const
+    {
+        size_t first = 0;
+        size_t n = count;
+        while (n > 0)
+        {
+            size_t half = n / 2;
+            if (compare(key(first + half), lookup) < 0)
+            {
+                first += half + 1;
+                n -= half + 1;
+            }
+            else
+                n = half;
+        }
+        return first;
+    }
+
+    template <typename TypeLookup>
+    bool contains(const TypeLookup& lookup) const
+    {
+        size_t i = lower_bound(lookup);
+        return i < count && compare(key(i), lookup) == 0;
+    }
+
+    template <typename TypeLookup>
+    typename TypeDataCodec::TypeView find(const TypeLookup& lookup) const
+    {
+        size_t i = lower_bound(lookup);
+        if (i < count && compare(key(i), lookup) == 0)
+            return value(i);
+        return typename TypeDataCodec::TypeView();
+    }
+};
@@ -0,0 +1,391 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+template <typename TypeValue, size_t Capacity>
+class pathStack
+{
+    TypeValue values[Capacity];
+    std::vector<TypeValue> spill;
+    size_t count;
+public:
+    pathStack() : count(0) {}
+
+    pathStack(const pathStack& other) : spill(other.spill), count(other.count)
+    {
+        std::copy(other.values, other.values + std::min(count, Capacity), values);
+    }
+
+    pathStack& operator=(const pathStack& other)
+    {
+        spill = other.spill;
+        count = other.count;
+        std::copy(other.values, other.values + std::min(count, Capacity), values);
+        return *this;
+    }
+
+    void push(const TypeValue& value)
+    {
+        if (count < Capacity)
+            values[count] = value;
+        else
+            spill.push_back(value);
+        ++count;
+    }
+
+    TypeValue pop()
+    {
+        if (--count < Capacity)
+            return values[count];
+        TypeValue value = spill.back();
+        spill.pop_back();
+        return value;
+    }
+
+    const TypeValue& top() const
+    {
+        return count > Capacity ? spill.back() : values[count - 1];
+    }
+
+    void truncate(size_t n)
+    {
+        count = n;
+        spill.resize(n > Capacity ? n - Capacity : 0);
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    bool empty() const
+    {
+        return count == 0;
+    }
+};
+
+template <typename TypeNode, size_t Capacity>
+class nodePath : public pathStack<TypeNode*, Capacity> {};
+
+template <typename TypeReference>
+struct iteratorArrow
+{
+    TypeReference value;
+
+    const TypeReference* operator->() const
+    {
+        return &value;
+    }
+};
+
+template <typename TypeNode, typename TypeKey, typename TypeData>
+struct plainCarry
+{
+    typedef std::pair<const TypeKey&, TypeData&> reference;
+
+    plainCarry() {}
+
+    template <typename TypeOther>
+    plainCarry(const TypeOther&, size_t) {}
+
+    void push(TypeNode*) {}
+    void pop() {}
+    void truncate(size_t) {}
+
+    reference view(TypeNode* p) const
+    {
+        return reference(p->key, p->data);
+    }
+};
+
+template <typename TypeNode, typename TypeKey, typename TypeData, size_t Capacity, typename TypeCarry = plainCarry<TypeNode, TypeKey, TypeData>>
+class pathIterator
+{
+    template <typename, typename, typename, size_t, typename> friend class pathIterator;
+
+    TypeNode* const* root;
+    TypeNode* node;
+    nodePath<TypeNode, Capacity> path;
+    TypeCarry carry;
+
+    void enter(TypeNode* p)
+    {
+        path.push(p);
+        carry.push(p);
+    }
+
+    TypeNode* leave()
+    {
+        carry.pop();
+        return path.pop();
+    }
+
+    void descendLeft(TypeNode* p)
+    {
+        while (p->left)
+        {
+            enter(p);
+            p = p->left;
+        }
+        node = p;
+    }
+
+    void descendRight(TypeNode* p)
+    {
+        while (p->right)
+        {
+            enter(p);
+            p = p->right;
+        }
+        node = p;
+    }
+public:
+    typedef std::bidirectional_iterator_tag iterator_category;
+    typedef std::pair<const TypeKey, typename std::remove_const<TypeData>::type> value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef typename TypeCarry::reference reference;
+    typedef iteratorArrow<reference> pointer;
+
+    pathIterator() : root(0), node(0) {}
+    explicit pathIterator(TypeNode* const* root_) : root(root_), node(0) {}
+
+    template <typename TypeOther, typename TypeOtherCarry>
+    pathIterator(const pathIterator<TypeNode, TypeKey, TypeOther, Capacity, TypeOtherCarry>& other) :
+        root(other.root), node(other.node), path(other.path), carry(other.carry, other.path.size()) {}
+
+    TypeNode* get() const
+    {
+        return node;
+    }
+
+    template <typename Less>
+    static pathIterator bound(TypeNode* const* root, Less before)
+    {
+        pathIterator it(root);
+        size_t keep = 0;
+        for (TypeNode* p = *root; p; )
+        {
+            if (before(p))
+            {
+                it.enter(p);
+                p = p->right;
+            }
+            else
+            {
+                it.node = p;
+                keep = it.path.size();
+                it.enter(p);
+                p = p->left;
+            }
+        }
+        it.path.truncate(keep);
+        it.carry.truncate(keep);
+        return it;
+    }
+
+    static pathIterator first(TypeNode* const* root)
+    {
+        pathIterator it(root);
+        if (*root) it.descendLeft(*root);
+        return it;
+    }
+
+    reference operator*() const
+    {
+        return carry.view(node);
+    }
+
+    pointer operator->() const
+    {
+        return pointer{ **this };
+    }
+
+    pathIterator& operator++()
+    {
+        if (node->right)
+        {
+            enter(node);
+            descendLeft(node->right);
+            return *this;
+        }
+        TypeNode* child = node;
+        while (!path.empty() && path.top()->right == child)
+            child = leave();
+        node = path.empty() ? 0 : leave();
+        return *this;
+    }
+
+    pathIterator& operator--()
+    {
+        if (!node)
+        {
+            descendRight(*root);
+            return *this;
+        }
+        if (node->left)
+        {
+            enter(node);
+            descendRight(node->left);
+            return *this;
+        }
+        TypeNode* child = node;
+        while (!path.empty() && path.top()->left == child)
+            child = leave();
+        node = path.empty() ? 0 : leave();
+        return *this;
+    }
+
+    pathIterator operator++(int)
+    {
+        pathIterator old = *this;
+        ++*this;
+        return old;
+    }
+
+    pathIterator operator--(int)
+    {
+        pathIterator old = *this;
+        --*this;
+        return old;
+    }
+
+    template <typename TypeOther, typename TypeOtherCarry>
+    bool operator==(const pathIterator<TypeNode, TypeKey, TypeOther, Capacity, TypeOtherCarry>& other) const
+    {
+        return node == other.node;
+    }
+
+    template <typename TypeOther, typename TypeOtherCarry>
+    bool operator!=(const pathIterator<TypeNode, TypeKey, TypeOther, Capacity, TypeOtherCarry>& other) const
+    {
+        return node != other.node;
+    }
+};
+
+template <typename TypeNode, typename TypeKey, typename TypeData>
+class parentIterator
+{
+    template <typename, typename, typename> friend class parentIterator;
+
+    TypeNode* const* root;
+    TypeNode* node;
+
+    static TypeNode* leftmost(TypeNode* p)
+    {
+        while (p->left)
+            p = p->left;
+        return p;
+    }
+
+    static TypeNode* rightmost(TypeNode* p)
+    {
+        while (p->right)
+            p = p->right;
+        return p;
+    }
+public:
+    typedef std::bidirectional_iterator_tag iterator_category;
+    typedef std::pair<const TypeKey, typename std::remove_const<TypeData>::type> value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef std::pair<const TypeKey&, TypeData&> reference;
+    typedef iteratorArrow<reference> pointer;
+
+    parentIterator() : root(0), node(0) {}
+    explicit parentIterator(TypeNode* const* root_, TypeNode* node_ = 0) : root(root_), node(node_) {}
+
+    template <typename TypeOther>
+    parentIterator(const parentIterator<TypeNode, TypeKey, TypeOther>& other) : root(other.root), node(other.node) {}
+
+    template <typename Less>
+    static parentIterator bound(TypeNode* const* root, Less before)
+    {
+        TypeNode* found = 0;
+        for (TypeNode* p = *root; p; )
+        {
+            if (before(p))
+                p = p->right;
+            else
+            {
+                found = p;
+                p = p->left;
+            }
+        }
+        return parentIterator(root, found);
+    }
+
+    static parentIterator first(TypeNode* const* root)
+    {
+        return parentIterator(root, *root ? leftmost(*root) : 0);
+    }
+
+    reference operator*() const
+    {
+        return reference(node->key, node->data);
+    }
+
+    pointer operator->() const
+    {
+        return pointer{ **this };
+    }
+
+    parentIterator& operator++()
+    {
+        if (node->right)
+        {
+            node = leftmost(node->right);
+            return *this;
+        }
+        while (node->parent && node->parent->right == node)
+            node = node->parent;
+        node = node->parent;
+        return *this;
+    }
+
+    parentIterator& operator--()
+    {
+        if (!node)
+        {
+            node = rightmost(*root);
+            return *this;
+        }
+        if (node->left)
+        {
+            node = rightmost(node->left);
+            return *this;
+        }
+        while (node->parent && node->parent->left == node)
+            node = node->parent;
+        node = node->parent;
+        return *this;
+    }
+
+    parentIterator operator++(int)
+    {
+        parentIterator old = *this;
+        ++*this;
+        return old;
+    }
+
+    parentIterator operator--(int)
+    {
+        parentIterator old = *this;
+        --*this;
+        return old;
+    }
+
+    template <typename TypeOther>
+    bool operator==(const parentIterator<TypeNode, TypeKey, TypeOther>& other) const
+    {
+        return node == other.node;
+    }
+
+    template <typename TypeOther>
+    bool operator!=(const parentIterator<TypeNode, TypeKey, TypeOther>& other) const
+    {
+        return node != other.node;
+    }
+};
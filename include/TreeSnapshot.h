@@ -0,0 +1,123 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <vector>
+#include "SimdSearch.h"
+
+template <size_t N>
+struct log2Floor
+{
+    static const int value = 1 + log2Floor<N / 2>::value;
+};
+
+template <>
+struct log2Floor<1>
+{
+    static const int value = 0;
+};
+
+template <typename TypeKey, typename TypeData>
+class TreeSnapshot
+{
+    static const size_t cacheLine = 64;
+    static const size_t keysPerLine = sizeof(TypeKey) >= cacheLine ? 1 : cacheLine / sizeof(TypeKey);
+    static const int prefetchLevels = log2Floor<keysPerLine>::value;
+
+    std::vector<TypeKey> keys;
+    std::vector<TypeData> data;
+    size_t offset;
+    size_t numElements;
+
+    size_t firstIndex() const
+    {
+        size_t k = 1;
+        while (2 * k <= numElements)
+            k *= 2;
+        return k;
+    }
+
+    size_t nextIndex(size_t k) const
+    {
+        if (2 * k + 1 <= numElements)
+        {
+            k = 2 * k + 1;
+            while (2 * k <= numElements)
+                k *= 2;
+            return k;
+        }
+        return k >> (countTrailingZeros(~static_cast<unsigned long long>(k)) + 1);
+    }
+
+    void allocate(size_t n)
+    {
+        numElements = n;
+        keys.assign(n + 1 + keysPerLine, TypeKey());
+        data.assign(n + 1, TypeData());
+        offset = 0;
+        while (offset < keysPerLine && reinterpret_cast<uintptr_t>(keys.data() + offset) % cacheLine != 0)
+            offset++;
+        if (offset == keysPerLine)
+            offset = 0;
+    }
+public:
+    TreeSnapshot() : offset(0), numElements(0) {}
+
+    template <typename Iterator>
+    void build(Iterator first, Iterator last)
+    {
+        allocate(std::distance(first, last));
+        size_t k = firstIndex();
+        for (; first != last; ++first)
+        {
+            keys[offset + k] = first->first;
+            data[k] = first->second;
+            k = nextIndex(k);
+        }
+    }
+
+    template <typename TypeTree>
+    void freeze(const TypeTree& tree)
+    {
+        size_t n = 0;
+        tree.for_each([&n](const TypeKey&, const TypeData&) { n++; });
+        allocate(n);
+        size_t k = firstIndex();
+        tree.for_each([this, &k](const TypeKey& key, const TypeData& value)
+        {
+            keys[offset + k] = key;
+            data[k] = value;
+            k = nextIndex(k);
+        });
+    }
+
+    TypeData find(const TypeKey& key) const
+    {
+        const TypeKey* base = keys.data() + offset;
+        uintptr_t address = reinterpret_cast<uintptr_t>(base);
+        size_t k = 1;
+        while (k <= numElements)
+        {
+            prefetchRead(reinterpret_cast<const void*>(address + (k << prefetchLevels) * sizeof(TypeKey)));
+            k = 2 * k + (base[k] < key);
+        }
+        k >>= countTrailingZeros(~static_cast<unsigned long long>(k)) + 1;
+        if (k && !(key < base[k]))
+            return data[k];
+        return TypeData();
+    }
+
+    size_t size() const
+    {
+        return numElements;
+    }
+
+    void clear()
+    {
+        keys.clear();
+        data.clear();
+        offset = 0;
+        numElements = 0;
+    }
+};
@@ -0,0 +1,119 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+enum treeOperation
+{
+    treeInsert,
+    treeErase,
+    treeFind,
+    treeBulk,
+    treeOperationCount
+};
+
+inline const char* treeOperationName(int operation)
+{
+    static const char* names[treeOperationCount] = { "insert", "erase", "find", "bulk" };
+    return names[operation];
+}
+
+struct treeCounters
+{
+    size_t operations;
+    size_t comparisons;
+    size_t rotations;
+    size_t restructures;
+
+    treeCounters() : operations(0), comparisons(0), rotations(0), restructures(0) {}
+};
+
+struct treeShape
+{
+    size_t size;
+    int height;
+    double averageDepth;
+
+    treeShape() : size(0), height(0), averageDepth(0) {}
+};
+
+struct noTreeStats
+{
+    static const bool enabled = false;
+
+    void begin(treeOperation) {}
+    void compare() {}
+    void rotate() {}
+    void restructure() {}
+    void reset() {}
+
+    treeCounters counters(treeOperation) const
+    {
+        return treeCounters();
+    }
+};
+
+class treeStats
+{
+    treeCounters values[treeOperationCount];
+    treeOperation current;
+public:
+    static const bool enabled = true;
+
+    treeStats() : current(treeBulk) {}
+
+    void begin(treeOperation operation)
+    {
+        current = operation;
+        values[operation].operations++;
+    }
+
+    void compare()
+    {
+        values[current].comparisons++;
+    }
+
+    void rotate()
+    {
+        values[current].rotations++;
+    }
+
+    void restructure()
+    {
+        values[current].restructures++;
+    }
+
+    void reset()
+    {
+        for (int i = 0; i < treeOperationCount; ++i)
+            values[i] = treeCounters();
+    }
+
+    treeCounters counters(treeOperation operation) const
+    {
+        return values[operation];
+    }
+};
+
+template <typename TypeNode>
+treeShape measureShape(const TypeNode* root)
+{
+    treeShape shape;
+    size_t depthSum = 0;
+    std::vector<std::pair<const TypeNode*, int>> stack;
+    if (root) stack.push_back(std::make_pair(root, 1));
+    while (!stack.empty())
+    {
+        const TypeNode* p = stack.back().first;
+        int depth = stack.back().second;
+        stack.pop_back();
+        shape.size++;
+        shape.height = std::max(shape.height, depth);
+        depthSum += depth;
+        if (p->left) stack.push_back(std::make_pair(p->left, depth + 1));
+        if (p->right) stack.push_back(std::make_pair(p->right, depth + 1));
+    }
+    shape.averageDepth = shape.size ? static_cast<double>(depthSum) / shape.size : 0;
+    return shape;
+}